@@ -0,0 +1,145 @@
+#include "legacy_router.h"
+#include "graph.h"
+#include "log_duration.h"
+#include "router.h"
+#include "thread_pool.h"
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct BenchSettings {
+    size_t stop_count = 1000;
+    size_t thread_count = 0;
+    uint32_t seed = 42;
+};
+
+constexpr size_t STOPS_PER_BUS = 20;
+constexpr double BUS_WAIT_TIME = 6.0;
+
+void PrintUsage(std::ostream& stream = std::cerr) {
+    stream << "Usage: router_bench [stop_count [thread_count [seed]]]\n"sv;
+}
+
+//Сеть, похожая на граф TransportRouter: у остановки s вершина ожидания 2s и вершина посадки 2s + 1,
+//ребро ожидания между ними. Каждый автобус проходит STOPS_PER_BUS случайных остановок, от вершины
+//посадки каждой остановки идут рёбра к вершинам ожидания всех следующих остановок автобуса.
+//Сеть задаётся только seed: используются сами значения mt19937, а не распределения стандартной
+//библиотеки, поэтому граф одинаков в любой сборке
+graph::DirectedWeightedGraph<double> GenerateNetwork(size_t stop_count, uint32_t seed) {
+    std::mt19937 generator(seed);
+    graph::DirectedWeightedGraph<double> network(stop_count * 2);
+    for (size_t stop = 0; stop < stop_count; ++stop) {
+        network.AddEdge({stop * 2, stop * 2 + 1, BUS_WAIT_TIME});
+    }
+    const size_t bus_count = stop_count / 10 + 1;
+    for (size_t bus = 0; bus < bus_count; ++bus) {
+        std::vector<size_t> stops(STOPS_PER_BUS);
+        std::vector<double> span_times(STOPS_PER_BUS);
+        for (size_t i = 0; i < STOPS_PER_BUS; ++i) {
+            stops[i] = generator() % stop_count;
+            span_times[i] = 1.0 + generator() % 100 / 10.0;
+        }
+        for (size_t from = 0; from < STOPS_PER_BUS; ++from) {
+            double time = 0.0;
+            for (size_t to = from + 1; to < STOPS_PER_BUS; ++to) {
+                time += span_times[to];
+                if (stops[from] != stops[to]) {
+                    network.AddEdge({stops[from] * 2 + 1, stops[to] * 2, time});
+                }
+            }
+        }
+    }
+    return network;
+}
+
+//Сверка весов всех маршрутов нового маршрутизатора с прежним. Порядок сложения весов
+//у блочного алгоритма другой, поэтому веса сравниваются с относительной погрешностью
+size_t CountMismatches(const legacy::Router<double>& expected, const graph::Router<double>& actual,
+                       size_t vertex_count) {
+    size_t mismatches = 0;
+    for (graph::VertexId from = 0; from < vertex_count; ++from) {
+        for (graph::VertexId to = 0; to < vertex_count; ++to) {
+            const auto expected_route = expected.BuildRoute(from, to);
+            const auto actual_route = actual.BuildRoute(from, to);
+            if (expected_route.has_value() != actual_route.has_value()) {
+                ++mismatches;
+            }
+            else if (expected_route
+                     && std::abs(expected_route->weight - actual_route->weight) > 1e-9 * expected_route->weight) {
+                ++mismatches;
+            }
+        }
+    }
+    return mismatches;
+}
+
+}  // namespace
+
+//Сравнение времени построения таблицы маршрутов между всеми парами вершин: прежний
+//маршрутизатор на вложенных optional против блочного graph::Router без пула и с пулом
+int main(int argc, char* argv[]) {
+    if (argc > 4) {
+        PrintUsage();
+        return 1;
+    }
+
+    BenchSettings settings;
+    try {
+        if (argc > 1) {
+            settings.stop_count = std::stoul(argv[1]);
+        }
+        if (argc > 2) {
+            settings.thread_count = std::stoul(argv[2]);
+        }
+        if (argc > 3) {
+            settings.seed = static_cast<uint32_t>(std::stoul(argv[3]));
+        }
+    }
+    catch (const std::exception&) {
+        PrintUsage();
+        return 1;
+    }
+    if (settings.stop_count == 0) {
+        PrintUsage();
+        return 1;
+    }
+
+    const graph::DirectedWeightedGraph<double> network = GenerateNetwork(settings.stop_count, settings.seed);
+    const graph::CsrGraph<double> csr_network(network);
+    const size_t vertex_count = network.GetVertexCount();
+    ThreadPool thread_pool(settings.thread_count);
+    std::cout << "vertices: "sv << vertex_count << ", edges: "sv << network.GetEdgeCount()
+              << ", seed: "sv << settings.seed << ", threads: "sv << thread_pool.GetThreadCount() << '\n';
+
+    std::optional<legacy::Router<double>> legacy_router;
+    {
+        LogDuration timer("legacy router", &std::cout);
+        legacy_router.emplace(network);
+    }
+    std::optional<graph::Router<double>> blocked_router;
+    {
+        LogDuration timer("blocked router", &std::cout);
+        blocked_router.emplace(csr_network);
+    }
+    std::optional<graph::Router<double>> pooled_router;
+    {
+        LogDuration timer("blocked router in pool", &std::cout);
+        pooled_router.emplace(csr_network, &thread_pool);
+    }
+
+    const size_t mismatches = CountMismatches(*legacy_router, *blocked_router, vertex_count)
+                              + CountMismatches(*legacy_router, *pooled_router, vertex_count);
+    std::cout << "mismatches: "sv << mismatches << '\n';
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,535 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Маршрутизатор на основе иерархий сжатия (Contraction Hierarchies).
+// При построении вершины стягиваются в порядке важности, а кратчайшие пути через
+// стянутую вершину заменяются ярлыками. Запрос — двунаправленный поиск только вверх
+// по иерархии, найденные ярлыки раскрываются обратно в исходные рёбра графа
+template <typename Weight>
+class ContractionRouter : public RouterBase<Weight> {
+private:
+    using Graph = CsrGraph<Weight>;
+
+public:
+    using typename RouterBase<Weight>::RouteInfo;
+
+    // Ярлык from -> to заменяет пару последовательных рёбер first и second.
+    // Идентификаторы ярлыков продолжают нумерацию рёбер графа: EdgeCount() + индекс ярлыка
+    struct Shortcut {
+        VertexId from;
+        VertexId to;
+        Weight weight;
+        EdgeId first;
+        EdgeId second;
+    };
+
+    explicit ContractionRouter(const Graph& graph);
+    explicit ContractionRouter(const Graph& graph, std::vector<uint32_t> ranks, std::vector<Shortcut> shortcuts);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+    const std::vector<uint32_t>& GetRanks() const;
+    const std::vector<Shortcut>& GetShortcuts() const;
+
+private:
+    // Дуга поискового графа: соседняя вершина, вес и идентификатор ребра или ярлыка
+    struct Arc {
+        VertexId vertex;
+        Weight weight;
+        EdgeId edge;
+    };
+
+    struct Label {
+        Weight weight;
+        std::optional<EdgeId> prev_edge;
+    };
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    using Queue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+
+    // Метки поиска в одном направлении. Массив на все вершины переиспользуется
+    // запросами одного потока, перед поиском сбрасываются только затронутые вершины
+    class Labels {
+    public:
+        void Reset(size_t vertex_count) {
+            for (const VertexId vertex : touched_) {
+                labels_[vertex].reset();
+            }
+            touched_.clear();
+            if (labels_.size() < vertex_count) {
+                labels_.resize(vertex_count);
+            }
+        }
+
+        const std::optional<Label>& Find(VertexId vertex) const {
+            return labels_[vertex];
+        }
+
+        // Обновляет метку, если новый вес меньше текущего
+        bool Relax(VertexId vertex, Weight weight, std::optional<EdgeId> prev_edge) {
+            auto& label = labels_[vertex];
+            if (!label) {
+                touched_.push_back(vertex);
+            } else if (!(weight < label->weight)) {
+                return false;
+            }
+            label = Label{weight, prev_edge};
+            return true;
+        }
+
+    private:
+        std::vector<std::optional<Label>> labels_;
+        std::vector<VertexId> touched_;
+    };
+
+    // Ограничение числа вершин, просматриваемых при поиске свидетеля во время стягивания
+    static constexpr size_t WITNESS_SETTLED_LIMIT = 100;
+    static constexpr Weight ZERO_WEIGHT{};
+
+    const Graph& graph_;
+    std::vector<uint32_t> ranks_;
+    std::vector<Shortcut> shortcuts_;
+
+    // Рёбра к вершинам с бо́льшим рангом (прямой поиск) и от них (обратный поиск)
+    std::vector<size_t> up_offsets_;
+    std::vector<Arc> up_arcs_;
+    std::vector<size_t> down_offsets_;
+    std::vector<Arc> down_arcs_;
+
+    class Contractor;
+
+    VertexId GetEdgeFrom(EdgeId edge_id) const;
+    VertexId GetEdgeTo(EdgeId edge_id) const;
+    Weight GetEdgeWeight(EdgeId edge_id) const;
+
+    void BuildSearchGraph();
+    void UnpackEdge(EdgeId edge_id, std::vector<EdgeId>& edges) const;
+
+    static void RelaxArcs(const std::vector<size_t>& offsets, const std::vector<Arc>& arcs,
+                          VertexId vertex, Weight weight, Labels& labels, Queue& queue);
+};
+
+// Стягивание вершин графа в порядке приоритета с его ленивым пересчётом
+template <typename Weight>
+class ContractionRouter<Weight>::Contractor {
+public:
+    Contractor(const Graph& graph, std::vector<Shortcut>& shortcuts)
+        : graph_(graph)
+        , shortcuts_(shortcuts)
+        , out_arcs_(graph.GetVertexCount())
+        , in_arcs_(graph.GetVertexCount())
+        , deleted_neighbors_(graph.GetVertexCount(), 0)
+        , levels_(graph.GetVertexCount(), 0)
+        , witness_weights_(graph.GetVertexCount())
+        , is_witness_target_(graph.GetVertexCount(), false)
+    {
+        for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            const auto edge = graph.GetEdge(edge_id);
+            if (edge.weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+            if (edge.from != edge.to) {
+                AddArc(edge.from, edge.to, edge.weight, edge_id);
+            }
+        }
+    }
+
+    std::vector<uint32_t> Contract() {
+        const size_t vertex_count = graph_.GetVertexCount();
+        using PriorityItem = std::pair<int64_t, VertexId>;
+        std::priority_queue<PriorityItem, std::vector<PriorityItem>, std::greater<PriorityItem>> queue;
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            queue.push({ComputePriority(vertex), vertex});
+        }
+
+        std::vector<uint32_t> ranks(vertex_count);
+        uint32_t next_rank = 0;
+        while (!queue.empty()) {
+            const VertexId vertex = queue.top().second;
+            queue.pop();
+            // Приоритет мог устареть после стягивания соседей: пересчитываем и при
+            // необходимости откладываем вершину
+            const int64_t priority = ComputePriority(vertex);
+            if (!queue.empty() && priority > queue.top().first) {
+                queue.push({priority, vertex});
+                continue;
+            }
+            ContractVertex(vertex);
+            ranks[vertex] = next_rank++;
+        }
+        return ranks;
+    }
+
+private:
+    struct WorkArc {
+        VertexId vertex;
+        Weight weight;
+        EdgeId edge;
+    };
+
+    const Graph& graph_;
+    std::vector<Shortcut>& shortcuts_;
+    std::vector<std::vector<WorkArc>> out_arcs_;
+    std::vector<std::vector<WorkArc>> in_arcs_;
+    std::vector<int64_t> deleted_neighbors_;
+    std::vector<int64_t> levels_;
+    std::vector<std::optional<Weight>> witness_weights_;
+    std::vector<VertexId> witness_touched_;
+    std::vector<bool> is_witness_target_;
+
+    // Добавляет дугу from -> to, если между вершинами ещё нет дуги не тяжелее
+    void AddArc(VertexId from, VertexId to, Weight weight, EdgeId edge_id) {
+        auto& out = out_arcs_[from];
+        const auto found = std::find_if(out.begin(), out.end(),
+                                        [to](const WorkArc& arc) { return arc.vertex == to; });
+        if (found == out.end()) {
+            out.push_back({to, weight, edge_id});
+            in_arcs_[to].push_back({from, weight, edge_id});
+            return;
+        }
+        if (!(weight < found->weight)) {
+            return;
+        }
+        *found = {to, weight, edge_id};
+        for (auto& arc : in_arcs_[to]) {
+            if (arc.vertex == from) {
+                arc = {from, weight, edge_id};
+                break;
+            }
+        }
+    }
+
+    static void RemoveArcsTo(std::vector<WorkArc>& arcs, VertexId vertex) {
+        arcs.erase(std::remove_if(arcs.begin(), arcs.end(),
+                                  [vertex](const WorkArc& arc) { return arc.vertex == vertex; }),
+                   arcs.end());
+    }
+
+    // Ограниченный поиск Дейкстры из source в оставшемся графе в обход вершины excluded.
+    // Завершается, когда достигнуты все target_count отмеченных вершин-целей
+    void FindWitnesses(VertexId source, VertexId excluded, Weight max_weight, size_t target_count) {
+        for (const VertexId vertex : witness_touched_) {
+            witness_weights_[vertex].reset();
+        }
+        witness_touched_.clear();
+
+        Queue queue;
+        witness_weights_[source] = ZERO_WEIGHT;
+        witness_touched_.push_back(source);
+        queue.push({ZERO_WEIGHT, source});
+        size_t settled = 0;
+        while (!queue.empty() && settled < WITNESS_SETTLED_LIMIT) {
+            const auto [weight, vertex] = queue.top();
+            queue.pop();
+            if (*witness_weights_[vertex] < weight) {
+                continue;
+            }
+            if (max_weight < weight) {
+                break;
+            }
+            ++settled;
+            if (is_witness_target_[vertex] && --target_count == 0) {
+                break;
+            }
+            for (const WorkArc& arc : out_arcs_[vertex]) {
+                if (arc.vertex == excluded) {
+                    continue;
+                }
+                const Weight candidate_weight = weight + arc.weight;
+                auto& weight_to = witness_weights_[arc.vertex];
+                if (!weight_to) {
+                    witness_touched_.push_back(arc.vertex);
+                }
+                if (!weight_to || candidate_weight < *weight_to) {
+                    weight_to = candidate_weight;
+                    queue.push({candidate_weight, arc.vertex});
+                }
+            }
+        }
+    }
+
+    // Вычисляет ярлыки, необходимые для стягивания вершины, и передаёт их в add_shortcut
+    template <typename Callback>
+    void ForEachShortcut(VertexId vertex, Callback add_shortcut) {
+        for (const WorkArc& out_arc : out_arcs_[vertex]) {
+            is_witness_target_[out_arc.vertex] = true;
+        }
+        for (const WorkArc& in_arc : in_arcs_[vertex]) {
+            Weight max_weight = ZERO_WEIGHT;
+            for (const WorkArc& out_arc : out_arcs_[vertex]) {
+                max_weight = std::max(max_weight, in_arc.weight + out_arc.weight);
+            }
+            FindWitnesses(in_arc.vertex, vertex, max_weight, out_arcs_[vertex].size());
+            for (const WorkArc& out_arc : out_arcs_[vertex]) {
+                if (out_arc.vertex == in_arc.vertex) {
+                    continue;
+                }
+                const Weight shortcut_weight = in_arc.weight + out_arc.weight;
+                const auto& witness_weight = witness_weights_[out_arc.vertex];
+                if (!witness_weight || shortcut_weight < *witness_weight) {
+                    add_shortcut(in_arc, out_arc, shortcut_weight);
+                }
+            }
+        }
+        for (const WorkArc& out_arc : out_arcs_[vertex]) {
+            is_witness_target_[out_arc.vertex] = false;
+        }
+    }
+
+    int64_t ComputePriority(VertexId vertex) {
+        int64_t shortcut_count = 0;
+        ForEachShortcut(vertex, [&shortcut_count](const WorkArc&, const WorkArc&, Weight) {
+            ++shortcut_count;
+        });
+        const int64_t removed_count = static_cast<int64_t>(in_arcs_[vertex].size() + out_arcs_[vertex].size());
+        // Разность рёбер с удвоенным весом, число уже стянутых соседей и глубина в иерархии
+        return 2 * (shortcut_count - removed_count) + deleted_neighbors_[vertex] + levels_[vertex];
+    }
+
+    void ContractVertex(VertexId vertex) {
+        std::vector<Shortcut> new_shortcuts;
+        ForEachShortcut(vertex, [&new_shortcuts](const WorkArc& in_arc, const WorkArc& out_arc, Weight weight) {
+            new_shortcuts.push_back({in_arc.vertex, out_arc.vertex, weight, in_arc.edge, out_arc.edge});
+        });
+
+        for (const WorkArc& arc : in_arcs_[vertex]) {
+            RemoveArcsTo(out_arcs_[arc.vertex], vertex);
+            ++deleted_neighbors_[arc.vertex];
+            levels_[arc.vertex] = std::max(levels_[arc.vertex], levels_[vertex] + 1);
+        }
+        for (const WorkArc& arc : out_arcs_[vertex]) {
+            RemoveArcsTo(in_arcs_[arc.vertex], vertex);
+            ++deleted_neighbors_[arc.vertex];
+            levels_[arc.vertex] = std::max(levels_[arc.vertex], levels_[vertex] + 1);
+        }
+        in_arcs_[vertex].clear();
+        out_arcs_[vertex].clear();
+
+        for (const Shortcut& shortcut : new_shortcuts) {
+            const EdgeId shortcut_id = graph_.GetEdgeCount() + shortcuts_.size();
+            shortcuts_.push_back(shortcut);
+            AddArc(shortcut.from, shortcut.to, shortcut.weight, shortcut_id);
+        }
+    }
+};
+
+template <typename Weight>
+ContractionRouter<Weight>::ContractionRouter(const Graph& graph)
+    : graph_(graph)
+{
+    ranks_ = Contractor(graph_, shortcuts_).Contract();
+    BuildSearchGraph();
+}
+
+template <typename Weight>
+ContractionRouter<Weight>::ContractionRouter(const Graph& graph, std::vector<uint32_t> ranks,
+                                             std::vector<Shortcut> shortcuts)
+    : graph_(graph)
+    , ranks_(std::move(ranks))
+    , shortcuts_(std::move(shortcuts))
+{
+    if (ranks_.size() != graph_.GetVertexCount()) {
+        throw std::invalid_argument("Ranks count doesn't match vertex count");
+    }
+    BuildSearchGraph();
+}
+
+template <typename Weight>
+VertexId ContractionRouter<Weight>::GetEdgeFrom(EdgeId edge_id) const {
+    const size_t edge_count = graph_.GetEdgeCount();
+    return edge_id < edge_count ? graph_.GetEdge(edge_id).from : shortcuts_[edge_id - edge_count].from;
+}
+
+template <typename Weight>
+VertexId ContractionRouter<Weight>::GetEdgeTo(EdgeId edge_id) const {
+    const size_t edge_count = graph_.GetEdgeCount();
+    return edge_id < edge_count ? graph_.GetEdge(edge_id).to : shortcuts_[edge_id - edge_count].to;
+}
+
+template <typename Weight>
+Weight ContractionRouter<Weight>::GetEdgeWeight(EdgeId edge_id) const {
+    const size_t edge_count = graph_.GetEdgeCount();
+    return edge_id < edge_count ? graph_.GetEdge(edge_id).weight : shortcuts_[edge_id - edge_count].weight;
+}
+
+template <typename Weight>
+void ContractionRouter<Weight>::BuildSearchGraph() {
+    const size_t vertex_count = graph_.GetVertexCount();
+    const size_t total_edge_count = graph_.GetEdgeCount() + shortcuts_.size();
+
+    up_offsets_.assign(vertex_count + 1, 0);
+    down_offsets_.assign(vertex_count + 1, 0);
+    for (EdgeId edge_id = 0; edge_id < total_edge_count; ++edge_id) {
+        const VertexId from = GetEdgeFrom(edge_id);
+        const VertexId to = GetEdgeTo(edge_id);
+        if (ranks_[from] < ranks_[to]) {
+            ++up_offsets_[from + 1];
+        } else if (ranks_[to] < ranks_[from]) {
+            ++down_offsets_[to + 1];
+        }
+    }
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        up_offsets_[vertex + 1] += up_offsets_[vertex];
+        down_offsets_[vertex + 1] += down_offsets_[vertex];
+    }
+
+    up_arcs_.resize(up_offsets_.back());
+    down_arcs_.resize(down_offsets_.back());
+    std::vector<size_t> up_positions(up_offsets_.begin(), std::prev(up_offsets_.end()));
+    std::vector<size_t> down_positions(down_offsets_.begin(), std::prev(down_offsets_.end()));
+    for (EdgeId edge_id = 0; edge_id < total_edge_count; ++edge_id) {
+        const VertexId from = GetEdgeFrom(edge_id);
+        const VertexId to = GetEdgeTo(edge_id);
+        const Weight weight = GetEdgeWeight(edge_id);
+        if (ranks_[from] < ranks_[to]) {
+            up_arcs_[up_positions[from]++] = {to, weight, edge_id};
+        } else if (ranks_[to] < ranks_[from]) {
+            down_arcs_[down_positions[to]++] = {from, weight, edge_id};
+        }
+    }
+}
+
+template <typename Weight>
+void ContractionRouter<Weight>::RelaxArcs(const std::vector<size_t>& offsets, const std::vector<Arc>& arcs,
+                                          VertexId vertex, Weight weight, Labels& labels, Queue& queue) {
+    for (size_t i = offsets[vertex]; i < offsets[vertex + 1]; ++i) {
+        const Arc& arc = arcs[i];
+        const Weight candidate_weight = weight + arc.weight;
+        if (labels.Relax(arc.vertex, candidate_weight, arc.edge)) {
+            queue.push({candidate_weight, arc.vertex});
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<typename ContractionRouter<Weight>::RouteInfo> ContractionRouter<Weight>::BuildRoute(VertexId from,
+                                                                                                   VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    thread_local Labels forward_labels;
+    thread_local Labels backward_labels;
+    forward_labels.Reset(vertex_count);
+    backward_labels.Reset(vertex_count);
+    forward_labels.Relax(from, ZERO_WEIGHT, std::nullopt);
+    backward_labels.Relax(to, ZERO_WEIGHT, std::nullopt);
+    Queue forward_queue;
+    Queue backward_queue;
+    forward_queue.push({ZERO_WEIGHT, from});
+    backward_queue.push({ZERO_WEIGHT, to});
+
+    std::optional<Weight> best_weight;
+    VertexId meeting_vertex = from;
+
+    // Шаг поиска в одном направлении; поиск в направлении завершается,
+    // когда минимум его очереди не меньше лучшего найденного пути
+    auto step = [&](Queue& queue, Labels& labels, const Labels& other_labels,
+                    const std::vector<size_t>& offsets, const std::vector<Arc>& arcs,
+                    const std::vector<size_t>& stall_offsets, const std::vector<Arc>& stall_arcs) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (labels.Find(vertex)->weight < weight) {
+            return;
+        }
+        if (best_weight && !(weight < *best_weight)) {
+            queue = Queue{};
+            return;
+        }
+        if (const auto& other = other_labels.Find(vertex)) {
+            const Weight candidate_weight = weight + other->weight;
+            if (!best_weight || candidate_weight < *best_weight) {
+                best_weight = candidate_weight;
+                meeting_vertex = vertex;
+            }
+        }
+        // Stall-on-demand: вершина достижима короче через более важного соседа,
+        // поэтому продолжать поиск из неё бессмысленно
+        for (size_t i = stall_offsets[vertex]; i < stall_offsets[vertex + 1]; ++i) {
+            const Arc& arc = stall_arcs[i];
+            if (const auto& label = labels.Find(arc.vertex); label && label->weight + arc.weight < weight) {
+                return;
+            }
+        }
+        RelaxArcs(offsets, arcs, vertex, weight, labels, queue);
+    };
+
+    while (!forward_queue.empty() || !backward_queue.empty()) {
+        if (!forward_queue.empty()
+            && (backward_queue.empty() || !(backward_queue.top().first < forward_queue.top().first))) {
+            step(forward_queue, forward_labels, backward_labels, up_offsets_, up_arcs_, down_offsets_, down_arcs_);
+        } else {
+            step(backward_queue, backward_labels, forward_labels, down_offsets_, down_arcs_, up_offsets_, up_arcs_);
+        }
+    }
+
+    if (!best_weight) {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> search_edges;
+    for (std::optional<EdgeId> edge_id = forward_labels.Find(meeting_vertex)->prev_edge;
+         edge_id;
+         edge_id = forward_labels.Find(GetEdgeFrom(*edge_id))->prev_edge)
+    {
+        search_edges.push_back(*edge_id);
+    }
+    std::reverse(search_edges.begin(), search_edges.end());
+    for (std::optional<EdgeId> edge_id = backward_labels.Find(meeting_vertex)->prev_edge;
+         edge_id;
+         edge_id = backward_labels.Find(GetEdgeTo(*edge_id))->prev_edge)
+    {
+        search_edges.push_back(*edge_id);
+    }
+
+    std::vector<EdgeId> edges;
+    for (const EdgeId edge_id : search_edges) {
+        UnpackEdge(edge_id, edges);
+    }
+
+    return RouteInfo{*best_weight, std::move(edges)};
+}
+
+// Раскрывает ярлык в последовательность исходных рёбер графа
+template <typename Weight>
+void ContractionRouter<Weight>::UnpackEdge(EdgeId edge_id, std::vector<EdgeId>& edges) const {
+    std::vector<EdgeId> stack{edge_id};
+    while (!stack.empty()) {
+        const EdgeId current = stack.back();
+        stack.pop_back();
+        if (current < graph_.GetEdgeCount()) {
+            edges.push_back(current);
+            continue;
+        }
+        const Shortcut& shortcut = shortcuts_[current - graph_.GetEdgeCount()];
+        stack.push_back(shortcut.second);
+        stack.push_back(shortcut.first);
+    }
+}
+
+template <typename Weight>
+const std::vector<uint32_t>& ContractionRouter<Weight>::GetRanks() const {
+    return ranks_;
+}
+
+template <typename Weight>
+const std::vector<typename ContractionRouter<Weight>::Shortcut>& ContractionRouter<Weight>::GetShortcuts() const {
+    return shortcuts_;
+}
+
+}  // namespace graph
@@ -1,10 +1,7 @@
 #include "domain.h"
 
 size_t PairStopsHasher::operator() (const PairStops& pair_stop) const {
-    size_t h_first = stop_hasher_(pair_stop.first);
-    size_t h_second = stop_hasher_(pair_stop.second);
-
-    return h_first + h_second * 37;
+    return std::hash<uint64_t>{}((static_cast<uint64_t>(pair_stop.first) << 32) | pair_stop.second);
 }
 
 
@@ -5,6 +5,8 @@
 #include "geo.h"
 
 #include <cmath>
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 #include <set>
@@ -14,12 +16,14 @@
 struct Stop {
     std::string stopname;
     geo::Coordinates coordinates;
+    uint32_t id = 0;    //номер остановки в порядке добавления в каталог
 };
 
 struct Bus {
     std::string busname;
     std::vector<const Stop*> stops;
     bool is_roundtrip = false;
+    uint32_t id = 0;    //номер маршрута в порядке добавления в каталог
 
     bool operator==(const Bus& other) const {
         return busname == other.busname;
@@ -67,10 +71,18 @@ struct StopsWithDistances {
 };
 
 
-using PairStops = std::pair<const Stop*, const Stop*>;
+//Расстояния по дорогам в формате CSR: соседи остановки с номером stop_id — это
+//neighbors[offsets[stop_id]..offsets[stop_id + 1]) по возрастанию номера, расстояния до них лежат
+//в distances по тем же позициям. Обратное расстояние, не заданное явно, равно прямому
+struct RoadDistances {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> neighbors;
+    std::vector<uint32_t> distances;
+};
+
+//Пара номеров остановок
+using PairStops = std::pair<uint32_t, uint32_t>;
 
 struct PairStopsHasher {
     size_t operator() (const PairStops& pair_stop) const ;
-private:
-    std::hash<const Stop*> stop_hasher_;
 };
@@ -2,7 +2,11 @@
 
 #include "ranges.h"
 
+#include <cstdint>
 #include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 namespace graph {
@@ -85,4 +89,127 @@ std::vector<std::vector<EdgeId>>& DirectedWeightedGraph<Weight>::GetIncidenceLis
     return incidence_lists_;
 }
 
+// Неизменяемый граф в формате CSR: рёбра упакованы в массивы по вершинам-источникам,
+// исходящие рёбра вершины v имеют номера [offsets[v], offsets[v + 1]).
+// Строится из DirectedWeightedGraph после добавления всех рёбер; рёбра при этом нумеруются
+// заново — по порядку вершин-источников, а внутри вершины — по порядку её списка инцидентности
+template <typename Weight>
+class CsrGraph {
+private:
+    using IncidentEdgesRange = ranges::Range<ranges::IndexIterator>;
+
+public:
+    CsrGraph() = default;
+    explicit CsrGraph(const DirectedWeightedGraph<Weight>& graph);
+    CsrGraph(std::vector<uint32_t> offsets, std::vector<uint32_t> targets, std::vector<Weight> weights);
+
+    size_t GetVertexCount() const;
+    size_t GetEdgeCount() const;
+    Edge<Weight> GetEdge(EdgeId edge_id) const;
+    IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
+
+    const std::vector<uint32_t>& GetOffsets() const;
+    const std::vector<uint32_t>& GetTargets() const;
+    const std::vector<Weight>& GetWeights() const;
+
+private:
+    std::vector<uint32_t> offsets_;
+    std::vector<uint32_t> sources_;
+    std::vector<uint32_t> targets_;
+    std::vector<Weight> weights_;
+
+    void FillSources();
+};
+
+template <typename Weight>
+CsrGraph<Weight>::CsrGraph(const DirectedWeightedGraph<Weight>& graph) {
+    const size_t vertex_count = graph.GetVertexCount();
+    const size_t edge_count = graph.GetEdgeCount();
+    if (vertex_count >= std::numeric_limits<uint32_t>::max() || edge_count >= std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("Graph is too large for CSR representation");
+    }
+    offsets_.reserve(vertex_count + 1);
+    targets_.reserve(edge_count);
+    weights_.reserve(edge_count);
+
+    offsets_.push_back(0);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+            const Edge<Weight>& edge = graph.GetEdge(edge_id);
+            targets_.push_back(static_cast<uint32_t>(edge.to));
+            weights_.push_back(edge.weight);
+        }
+        offsets_.push_back(static_cast<uint32_t>(targets_.size()));
+    }
+    FillSources();
+}
+
+template <typename Weight>
+CsrGraph<Weight>::CsrGraph(std::vector<uint32_t> offsets, std::vector<uint32_t> targets, std::vector<Weight> weights)
+    : offsets_(std::move(offsets))
+    , targets_(std::move(targets))
+    , weights_(std::move(weights))
+{
+    if (offsets_.empty() || offsets_.front() != 0 || offsets_.back() != targets_.size()
+        || weights_.size() != targets_.size()) {
+        throw std::invalid_argument("Inconsistent CSR graph arrays");
+    }
+    for (size_t vertex = 0; vertex + 1 < offsets_.size(); ++vertex) {
+        if (offsets_[vertex] > offsets_[vertex + 1]) {
+            throw std::invalid_argument("Inconsistent CSR graph arrays");
+        }
+    }
+    for (const uint32_t target : targets_) {
+        if (target >= GetVertexCount()) {
+            throw std::invalid_argument("Inconsistent CSR graph arrays");
+        }
+    }
+    FillSources();
+}
+
+template <typename Weight>
+void CsrGraph<Weight>::FillSources() {
+    sources_.resize(targets_.size());
+    for (size_t vertex = 0; vertex + 1 < offsets_.size(); ++vertex) {
+        for (uint32_t edge_id = offsets_[vertex]; edge_id < offsets_[vertex + 1]; ++edge_id) {
+            sources_[edge_id] = static_cast<uint32_t>(vertex);
+        }
+    }
+}
+
+template <typename Weight>
+size_t CsrGraph<Weight>::GetVertexCount() const {
+    return offsets_.empty() ? 0 : offsets_.size() - 1;
+}
+
+template <typename Weight>
+size_t CsrGraph<Weight>::GetEdgeCount() const {
+    return targets_.size();
+}
+
+template <typename Weight>
+Edge<Weight> CsrGraph<Weight>::GetEdge(EdgeId edge_id) const {
+    return {sources_.at(edge_id), targets_[edge_id], weights_[edge_id]};
+}
+
+template <typename Weight>
+typename CsrGraph<Weight>::IncidentEdgesRange CsrGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
+    return ranges::Indices(offsets_.at(vertex), offsets_.at(vertex + 1));
+}
+
+template <typename Weight>
+const std::vector<uint32_t>& CsrGraph<Weight>::GetOffsets() const {
+    return offsets_;
+}
+
+template <typename Weight>
+const std::vector<uint32_t>& CsrGraph<Weight>::GetTargets() const {
+    return targets_;
+}
+
+template <typename Weight>
+const std::vector<Weight>& CsrGraph<Weight>::GetWeights() const {
+    return weights_;
+}
+
 }  // namespace graph
@@ -0,0 +1,106 @@
+#include "grid_index.h"
+
+#include <algorithm>
+
+namespace renderer {
+
+bool Rect::Intersects(const Rect& other) const {
+    return min.x <= other.max.x && other.min.x <= max.x
+        && min.y <= other.max.y && other.min.y <= max.y;
+}
+
+Rect Rect::Union(const Rect& other) const {
+    return {{std::min(min.x, other.min.x), std::min(min.y, other.min.y)},
+            {std::max(max.x, other.max.x), std::max(max.y, other.max.y)}};
+}
+
+Rect Rect::Expanded(double margin) const {
+    return {{min.x - margin, min.y - margin}, {max.x + margin, max.y + margin}};
+}
+
+GridIndex::GridIndex(const Rect& bounds, size_t max_cells_per_side, std::vector<Item> items)
+    : bounds_(bounds)
+    , items_(std::move(items)) {
+    SetCellsPerSide(max_cells_per_side);
+    while (cells_per_side_ > 1 && CountEntries() > MAX_AVERAGE_CELLS * std::max<size_t>(items_.size(), 1)) {
+        SetCellsPerSide(cells_per_side_ / 2);
+    }
+    offsets_.assign(cells_per_side_ * cells_per_side_ + 1, 0);
+
+    // Два прохода: подсчёт прямоугольников в ячейках, затем раскладка их номеров по ячейкам
+    auto for_each_cell = [this](const Rect& rect, auto action) {
+        for (size_t row = GetRow(rect.min.y); row <= GetRow(rect.max.y); ++row) {
+            for (size_t column = GetColumn(rect.min.x); column <= GetColumn(rect.max.x); ++column) {
+                action(row * cells_per_side_ + column);
+            }
+        }
+    };
+    for (const Item& item : items_) {
+        for_each_cell(item.rect, [this](size_t cell) {
+            ++offsets_[cell + 1];
+        });
+    }
+    for (size_t cell = 1; cell < offsets_.size(); ++cell) {
+        offsets_[cell] += offsets_[cell - 1];
+    }
+    item_nums_.resize(offsets_.back());
+    std::vector<uint32_t> filled(offsets_.begin(), offsets_.end() - 1);
+    for (uint32_t num = 0; num < items_.size(); ++num) {
+        for_each_cell(items_[num].rect, [this, &filled, num](size_t cell) {
+            item_nums_[filled[cell]++] = num;
+        });
+    }
+}
+
+std::vector<uint32_t> GridIndex::Find(const Rect& area) const {
+    std::vector<uint32_t> result;
+    if (cells_per_side_ == 0) {
+        return result;
+    }
+    for (size_t row = GetRow(area.min.y); row <= GetRow(area.max.y); ++row) {
+        for (size_t column = GetColumn(area.min.x); column <= GetColumn(area.max.x); ++column) {
+            const size_t cell = row * cells_per_side_ + column;
+            for (uint32_t i = offsets_[cell]; i < offsets_[cell + 1]; ++i) {
+                const Item& item = items_[item_nums_[i]];
+                if (item.rect.Intersects(area)) {
+                    result.push_back(item.id);
+                }
+            }
+        }
+    }
+    // Объект, занимающий несколько ячеек или прямоугольников, найден несколько раз
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+void GridIndex::SetCellsPerSide(size_t cells_per_side) {
+    cells_per_side_ = std::max<size_t>(cells_per_side, 1);
+    cell_width_ = (bounds_.max.x - bounds_.min.x) / cells_per_side_;
+    cell_height_ = (bounds_.max.y - bounds_.min.y) / cells_per_side_;
+}
+
+size_t GridIndex::CountEntries() const {
+    size_t count = 0;
+    for (const Item& item : items_) {
+        count += (GetRow(item.rect.max.y) - GetRow(item.rect.min.y) + 1)
+               * (GetColumn(item.rect.max.x) - GetColumn(item.rect.min.x) + 1);
+    }
+    return count;
+}
+
+size_t GridIndex::GetColumn(double x) const {
+    if (!(cell_width_ > 0.0) || x <= bounds_.min.x) {
+        return 0;
+    }
+    return std::min(static_cast<size_t>((x - bounds_.min.x) / cell_width_), cells_per_side_ - 1);
+}
+
+size_t GridIndex::GetRow(double y) const {
+    if (!(cell_height_ > 0.0) || y <= bounds_.min.y) {
+        return 0;
+    }
+    return std::min(static_cast<size_t>((y - bounds_.min.y) / cell_height_), cells_per_side_ - 1);
+}
+
+} //renderer
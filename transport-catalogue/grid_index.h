@@ -0,0 +1,60 @@
+#pragma once
+
+#include "svg.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace renderer {
+
+// Прямоугольная область в координатах SVG-изображения
+struct Rect {
+    svg::Point min;
+    svg::Point max;
+
+    bool Intersects(const Rect& other) const;
+    // Наименьший прямоугольник, содержащий оба
+    Rect Union(const Rect& other) const;
+    Rect Expanded(double margin) const;
+};
+
+// Пространственный индекс: равномерная сетка над прямоугольником bounds. Каждый прямоугольник
+// записывается во все ячейки, которые он пересекает; прямоугольники за границами bounds попадают
+// в крайние ячейки. Ячейки хранятся подряд, как строки CSR-матрицы
+class GridIndex {
+public:
+    // Прямоугольник, принадлежащий объекту с номером id. У объекта может быть несколько
+    // прямоугольников, например по одному на каждый отрезок ломаной
+    struct Item {
+        Rect rect;
+        uint32_t id = 0;
+    };
+
+    GridIndex() = default;
+    // Сетка не мельче max_cells_per_side ячеек на сторону. Если прямоугольники в среднем
+    // занимают больше MAX_AVERAGE_CELLS ячеек, сетка укрупняется, чтобы индекс не разрастался
+    GridIndex(const Rect& bounds, size_t max_cells_per_side, std::vector<Item> items);
+
+    // Номера объектов, хотя бы один прямоугольник которых пересекает area, по возрастанию
+    std::vector<uint32_t> Find(const Rect& area) const;
+
+private:
+    static constexpr size_t MAX_AVERAGE_CELLS = 16;
+
+    Rect bounds_;
+    size_t cells_per_side_ = 0;
+    double cell_width_ = 0.0;
+    double cell_height_ = 0.0;
+    std::vector<Item> items_;
+    // Номера прямоугольников ячейки cell — item_nums_[offsets_[cell]..offsets_[cell + 1])
+    std::vector<uint32_t> offsets_;
+    std::vector<uint32_t> item_nums_;
+
+    void SetCellsPerSide(size_t cells_per_side);
+    // Число записей в ячейках при текущем размере сетки
+    size_t CountEntries() const;
+    size_t GetColumn(double x) const;
+    size_t GetRow(double y) const;
+};
+
+} //renderer
@@ -1,252 +1,496 @@
 #include "json.h"
 
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
 namespace json {
 
 namespace {
 
-Node LoadNode(std::istream& input);
+using namespace std::literals;
 
-Number LoadNumber(std::istream& input) {
-    using namespace std::literals;
+bool IsWhitespace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
 
-    std::string parsed_num;
+// Символы, которые прерывают быстрый просмотр тела строки
+bool IsStringSpecial(char c) {
+    return c == '"' || c == '\\' || c == '\n' || c == '\r';
+}
 
-    // Считывает в parsed_num очередной символ из input
-    auto read_char = [&parsed_num, &input] {
-        parsed_num += static_cast<char>(input.get());
-        if (!input) {
-            throw ParsingError("Failed to read number from stream"s);
+#ifdef __SSE2__
+// Маска байтов блока из 16 символов, равных c
+inline int MatchMask(__m128i block, char c) {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(c)));
+}
+#endif
+
+// Первый непробельный символ в [begin, end) или end
+const char* FindNonWhitespace(const char* begin, const char* end) {
+#ifdef __SSE2__
+    for (; end - begin >= 16; begin += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        const int whitespace = MatchMask(block, ' ') | MatchMask(block, '\n')
+                             | MatchMask(block, '\r') | MatchMask(block, '\t');
+        if (whitespace != 0xFFFF) {
+            return begin + __builtin_ctz(~whitespace);
         }
-    };
+    }
+#endif
+    while (begin != end && IsWhitespace(*begin)) {
+        ++begin;
+    }
+    return begin;
+}
 
-    // Считывает одну или более цифр в parsed_num из input
-    auto read_digits = [&input, read_char] {
-        if (!std::isdigit(input.peek())) {
-            throw ParsingError("A digit is expected"s);
+// Первая кавычка, обратная косая черта или перевод строки в [begin, end) или end
+const char* FindStringSpecial(const char* begin, const char* end) {
+#ifdef __SSE2__
+    for (; end - begin >= 16; begin += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        const int special = MatchMask(block, '"') | MatchMask(block, '\\')
+                          | MatchMask(block, '\n') | MatchMask(block, '\r');
+        if (special != 0) {
+            return begin + __builtin_ctz(special);
         }
-        while (std::isdigit(input.peek())) {
-            read_char();
+    }
+#endif
+    while (begin != end && !IsStringSpecial(*begin)) {
+        ++begin;
+    }
+    return begin;
+}
+
+bool IsNumberChar(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+// Очередной символ без его извлечения; EOF, если данные закончились
+int Peek(Reader& reader) {
+    if (reader.Begin() == reader.End() && !reader.Refill()) {
+        return EOF;
+    }
+    return static_cast<unsigned char>(*reader.Begin());
+}
+
+// Извлекает очередной символ; EOF, если данные закончились
+int Get(Reader& reader) {
+    const int c = Peek(reader);
+    if (c != EOF) {
+        reader.Advance(1);
+    }
+    return c;
+}
+
+// Пропускает пробельные символы и извлекает следующий за ними символ
+int GetAfterWhitespace(Reader& reader) {
+    reader.SkipWhitespace();
+    return Get(reader);
+}
+
+// Проверяет, что число в [begin, end) записано по грамматике JSON. is_int — нет дробной части и экспоненты
+bool IsJsonNumber(const char* begin, const char* end, bool& is_int) {
+    auto is_digit = [&begin, end] {
+        return begin != end && *begin >= '0' && *begin <= '9';
+    };
+    auto skip_digits = [&begin, is_digit] {
+        if (!is_digit()) {
+            return false;
         }
+        while (is_digit()) {
+            ++begin;
+        }
+        return true;
     };
 
-    if (input.peek() == '-') {
-        read_char();
+    is_int = true;
+    if (begin != end && *begin == '-') {
+        ++begin;
     }
-    // Парсим целую часть числа
-    if (input.peek() == '0') {
-        read_char();
-        // После 0 в JSON не могут идти другие цифры
-    } else {
-        read_digits();
+    // После 0 в JSON не могут идти другие цифры
+    if (begin != end && *begin == '0') {
+        ++begin;
+    } else if (!skip_digits()) {
+        return false;
     }
-
-    bool is_int = true;
-    // Парсим дробную часть числа
-    if (input.peek() == '.') {
-        read_char();
-        read_digits();
+    if (begin != end && *begin == '.') {
+        ++begin;
         is_int = false;
+        if (!skip_digits()) {
+            return false;
+        }
     }
+    if (begin != end && (*begin == 'e' || *begin == 'E')) {
+        ++begin;
+        is_int = false;
+        if (begin != end && (*begin == '+' || *begin == '-')) {
+            ++begin;
+        }
+        if (!skip_digits()) {
+            return false;
+        }
+    }
+    return begin == end;
+}
 
-    // Парсим экспоненциальную часть числа
-    if (int ch = input.peek(); ch == 'e' || ch == 'E') {
-        read_char();
-        if (ch = input.peek(); ch == '+' || ch == '-') {
-            read_char();
+Node ConvertNumber(const char* begin, const char* end) {
+    bool is_int = true;
+    if (!IsJsonNumber(begin, end, is_int)) {
+        throw ParsingError("Failed to convert "s + std::string(begin, end) + " to number"s);
+    }
+    if (is_int) {
+        int int_value = 0;
+        const auto [ptr, ec] = std::from_chars(begin, end, int_value);
+        if (ec == std::errc{} && ptr == end) {
+            return Node(int_value);
         }
-        read_digits();
-        is_int = false;
+        // При переполнении int число читается как double
+    }
+    double double_value = 0.0;
+    const auto [ptr, ec] = std::from_chars(begin, end, double_value);
+    if (ec != std::errc{} || ptr != end) {
+        throw ParsingError("Failed to convert "s + std::string(begin, end) + " to number"s);
     }
+    return Node(double_value);
+}
 
-    try {
-        if (is_int) {
-            // Сначала пробуем преобразовать строку в int
-            try {
-                return std::stoi(parsed_num);
-            } catch (...) {
-                // В случае неудачи, например, при переполнении,
-                // код ниже попробует преобразовать строку в double
-            }
+Node LoadNumber(Reader& reader) {
+    const char* begin = reader.Begin();
+    const char* end = std::find_if_not(begin, reader.End(), IsNumberChar);
+    if (end != reader.End()) {
+        // Число целиком в буфере
+        reader.Advance(end - begin);
+        return ConvertNumber(begin, end);
+    }
+    // Число продолжается за концом буфера
+    std::string number(begin, end);
+    reader.Advance(end - begin);
+    while (reader.Refill()) {
+        begin = reader.Begin();
+        end = std::find_if_not(begin, reader.End(), IsNumberChar);
+        number.append(begin, end);
+        reader.Advance(end - begin);
+        if (end != reader.End()) {
+            break;
         }
-        return std::stod(parsed_num);
-    } catch (...) {
-        throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
     }
+    return ConvertNumber(number.data(), number.data() + number.size());
 }
 
 // Считывает содержимое строкового литерала JSON-документа
 // Функцию следует использовать после считывания открывающего символа ":
-std::string LoadString(std::istream& input) {
-
-        using namespace std::literals;
-
-        auto it = std::istreambuf_iterator<char>(input);
-        auto end = std::istreambuf_iterator<char>();
-        std::string s;
-        while (true) {
-            if (it == end) {
-                // Поток закончился до того, как встретили закрывающую кавычку?
-                throw ParsingError("String parsing error");
-            }
-            const char ch = *it;
-            if (ch == '"') {
-                // Встретили закрывающую кавычку
-                ++it;
-                break;
-            } else if (ch == '\\') {
-                // Встретили начало escape-последовательности
-                ++it;
-                if (it == end) {
+std::string LoadString(Reader& reader) {
+    std::string s;
+    while (true) {
+        // Обычные символы переносятся в результат целыми участками
+        const char* begin = reader.Begin();
+        const char* special = FindStringSpecial(begin, reader.End());
+        s.append(begin, special);
+        reader.Advance(special - begin);
+
+        const int ch = Get(reader);
+        if (ch == EOF) {
+            // Поток закончился до того, как встретили закрывающую кавычку?
+            throw ParsingError("String parsing error");
+        }
+        if (ch == '"') {
+            // Встретили закрывающую кавычку
+            break;
+        }
+        if (ch == '\n' || ch == '\r') {
+            // Строковый литерал внутри- JSON не может прерываться символами \r или \n
+            throw ParsingError("Unexpected end of line"s);
+        }
+        if (ch != '\\') {
+            // Буфер закончился посреди строки, и после дочитывания пришёл обычный символ
+            s.push_back(static_cast<char>(ch));
+        }
+        else {
+            // Встретили начало escape-последовательности
+            const int escaped_char = Get(reader);
+            // Обрабатываем одну из последовательностей: \\, \n, \t, \r, \"
+            switch (escaped_char) {
+                case 'n':
+                    s.push_back('\n');
+                    break;
+                case 't':
+                    s.push_back('\t');
+                    break;
+                case 'r':
+                    s.push_back('\r');
+                    break;
+                case '"':
+                    s.push_back('"');
+                    break;
+                case '\\':
+                    s.push_back('\\');
+                    break;
+                case EOF:
                     // Поток завершился сразу после символа обратной косой черты
                     throw ParsingError("String parsing error");
-                }
-                const char escaped_char = *(it);
-                // Обрабатываем одну из последовательностей: \\, \n, \t, \r, \"
-                switch (escaped_char) {
-                    case 'n':
-                        s.push_back('\n');
-                        break;
-                    case 't':
-                        s.push_back('\t');
-                        break;
-                    case 'r':
-                        s.push_back('\r');
-                        break;
-                    case '"':
-                        s.push_back('"');
-                        break;
-                    case '\\':
-                        s.push_back('\\');
-                        break;
-                    default:
-                        // Встретили неизвестную escape-последовательность
-                        throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
-                }
-            } else if (ch == '\n' || ch == '\r') {
-                // Строковый литерал внутри- JSON не может прерываться символами \r или \n
-                throw ParsingError("Unexpected end of line"s);
-            } else {
-                // Просто считываем очередной символ и помещаем его в результирующую строку
-                s.push_back(ch);
+                default:
+                    // Встретили неизвестную escape-последовательность
+                    throw ParsingError("Unrecognized escape sequence \\"s + static_cast<char>(escaped_char));
             }
-            ++it;
         }
+    }
+    return s;
+}
 
-        return s;
+// Проверяет символ escape-последовательности, следующий за обратной косой чертой
+void CheckEscape(char c) {
+    if (c != 'n' && c != 't' && c != 'r' && c != '"' && c != '\\') {
+        throw ParsingError("Unrecognized escape sequence \\"s + c);
+    }
 }
 
-Node LoadArray(istream& input) {
-    Array result;
-    char c = ' ';
-    for (; input >> c && c != ']';) {
-        if (c != ',') {
-            input.putback(c);
-        }
-        result.push_back(LoadNode(input));
+// Ищет закрывающую кавычку строкового литерала в [begin, end), не раскрывая escape-последовательности;
+// end, если литерал продолжается дальше. is_escaped — в литерале встретилась escape-последовательность.
+// is_after_backslash — участок начинается сразу после обратной косой черты; на выходе — участок ею закончился
+const char* FindStringEnd(const char* begin, const char* end, bool& is_escaped, bool& is_after_backslash) {
+    if (is_after_backslash && begin != end) {
+        CheckEscape(*begin++);
+        is_after_backslash = false;
     }
-    if (c != ']') {
-        throw ParsingError("Array parsing error"s);
+    while (true) {
+        begin = FindStringSpecial(begin, end);
+        if (begin == end || *begin == '"') {
+            return begin;
+        }
+        if (*begin != '\\') {
+            throw ParsingError("Unexpected end of line"s);
+        }
+        is_escaped = true;
+        if (++begin == end) {
+            is_after_backslash = true;
+            return end;
+        }
+        CheckEscape(*begin++);
     }
-
-    return Node(move(result));
 }
 
-Node LoadDict(istream& input) {
-    Dict result;
-
-    char c = ' ';
-    for (; input >> c && c != '}';) {
-        if (c == ',') {
-            input >> c;
+// Заменяет проверенные escape-последовательности символами и возвращает новую длину строки.
+// Последовательность из двух символов заменяется одним, поэтому замена идёт на месте
+std::size_t UnescapeInPlace(char* chars, std::size_t size) {
+    char* output = chars;
+    for (std::size_t i = 0; i < size; ++i) {
+        char c = chars[i];
+        if (c == '\\') {
+            c = chars[++i];
+            if (c == 'n') {
+                c = '\n';
+            } else if (c == 't') {
+                c = '\t';
+            } else if (c == 'r') {
+                c = '\r';
+            }
         }
-
-        string key = LoadString(input);
-        input >> c;
-        result.insert({move(key), LoadNode(input)});
-    }
-    if (c != '}') {
-        throw ParsingError("Dict parsing error"s);
+        *output++ = c;
     }
+    return output - chars;
+}
 
-    return Node(move(result));
+//Проверка на равенство слова из потока; первая буква слова уже прочитана
+void CheckWord(std::string_view word, Reader& reader) {
+    for (size_t i = 1; i < word.size(); ++i) {
+        if (Get(reader) != word[i]) {
+            throw ParsingError("Failed to read "s + std::string(word));
+        }
+    }
 }
 
-//Удаление лишних символов в начале
-void DeletePrefix(istream& input) {
-    char c;
-    input >> c;
+// Считывает значение null, bool, число или строку, первый символ которого c уже прочитан
+Node LoadScalar(Reader& reader, int c) {
+    if (c == '"') {
+        return Node(LoadString(reader));
+    } else if (c == 'n') {
+        CheckWord("null"sv, reader);
+        return Node();
+    } else if (c == 't') {
+        CheckWord("true"sv, reader);
+        return Node{true};
+    } else if (c == 'f') {
+        CheckWord("false"sv, reader);
+        return Node{false};
+    } else if ((c >= '0' && c <= '9') || c == '-') {
+        reader.Advance(-1);
+        return LoadNumber(reader);
+    }
+    throw ParsingError("Parsing error");
+}
 
-    while(c == ' ' || c == '\\') {
-        if (c == '\\') {
-            input >> c;
+// Вызывает load_item для каждого элемента массива, открывающая скобка уже прочитана
+template <typename LoadItem>
+void LoadArrayItems(Reader& reader, LoadItem load_item) {
+    reader.SkipWhitespace();
+    if (Peek(reader) == ']') {
+        reader.Advance(1);
+        return;
+    }
+    while (true) {
+        load_item();
+        const int c = GetAfterWhitespace(reader);
+        if (c == ']') {
+            return;
+        }
+        if (c != ',') {
+            throw ParsingError("Array parsing error"s);
         }
-        input >> c;
     }
-    input.putback(c);
 }
 
-bool CheckWord(const std::string& str, istream& input) {
-
-    for(size_t i = 0; i < str.size(); ++i) {
-        char c = EOF;
-        input >> c;
-        if (str[i] != c) {
-            input.putback(c);
-            return false;
+// Вызывает load_item(load_key()) для каждого элемента словаря, открывающая скобка уже прочитана.
+// load_key читает ключ после его открывающей кавычки
+template <typename LoadKey, typename LoadItem>
+void LoadDictItems(Reader& reader, LoadKey load_key, LoadItem load_item) {
+    int c = GetAfterWhitespace(reader);
+    if (c == '}') {
+        return;
+    }
+    while (true) {
+        if (c != '"') {
+            throw ParsingError("Dict parsing error"s);
+        }
+        auto key = load_key();
+        if (GetAfterWhitespace(reader) != ':') {
+            throw ParsingError("Dict parsing error"s);
+        }
+        load_item(std::move(key));
+        c = GetAfterWhitespace(reader);
+        if (c == '}') {
+            return;
+        }
+        if (c != ',') {
+            throw ParsingError("Dict parsing error"s);
         }
+        c = GetAfterWhitespace(reader);
     }
-    return true;
 }
 
-Node LoadNode(istream& input) {
-    DeletePrefix(input);
-    char c;
-    input >> c;
+Node LoadNode(Reader& reader) {
+    const int c = GetAfterWhitespace(reader);
+    if (c == '[') {
+        Array result;
+        LoadArrayItems(reader, [&reader, &result] {
+            result.push_back(LoadNode(reader));
+        });
+        return Node(move(result));
+    } else if (c == '{') {
+        Dict result;
+        LoadDictItems(reader, [&reader] {
+            return LoadString(reader);
+        }, [&reader, &result](std::string key) {
+            result.insert({move(key), LoadNode(reader)});
+        });
+        return Node(move(result));
+    }
+    return LoadScalar(reader, c);
+}
 
+void ParseNode(Reader& reader, Handler& handler) {
+    if (ArenaDocument* document = handler.GetValueDocument()) {
+        handler.Value(document->Load(reader));
+        return;
+    }
+    const int c = GetAfterWhitespace(reader);
     if (c == '[') {
-        return LoadArray(input);
+        handler.StartArray();
+        LoadArrayItems(reader, [&reader, &handler] {
+            ParseNode(reader, handler);
+        });
+        handler.EndArray();
     } else if (c == '{') {
-        return LoadDict(input);
-    } else if (c == '"') {
-        return Node(LoadString(input));
-    } else if (c == 'n') {
-        input.putback(c);
+        handler.StartDict();
+        LoadDictItems(reader, [&reader] {
+            return LoadString(reader);
+        }, [&reader, &handler](std::string key) {
+            handler.Key(move(key));
+            ParseNode(reader, handler);
+        });
+        handler.EndDict();
+    } else {
+        handler.Value(LoadScalar(reader, c));
+    }
+}
 
-        if (CheckWord("null", input)) {
-            return Node();
-        }
+}  // namespace
 
-        throw ParsingError("Null parsing error");
-    } else if (c == 't' || c == 'f') {
-        input.putback(c);
+Reader::Reader(std::string_view text)
+    : begin_(text.data())
+    , end_(text.data() + text.size()) {
+}
 
-        if (CheckWord("true", input)) {
-            return Node{true};
-        }
-        else if (CheckWord("false", input)) {
-            return Node{false};
-        }
-        throw ParsingError("Bool parsing error");
+Reader::Reader(std::istream& input)
+    : input_(&input)
+    , buffer_(BLOCK_SIZE) {
+}
+
+const char* Reader::Begin() const {
+    return begin_;
+}
+
+const char* Reader::End() const {
+    return end_;
+}
+
+void Reader::Advance(std::ptrdiff_t count) {
+    begin_ += count;
+}
+
+bool Reader::Refill() {
+    if (input_ == nullptr || begin_ != end_) {
+        return begin_ != end_;
+    }
+    std::streambuf& source = *input_->rdbuf();
+    // Ждём хотя бы один символ, затем забираем всё, что уже доступно без ожидания
+    std::streamsize count = source.sgetn(buffer_.data(), 1);
+    if (count == 0) {
+        input_->setstate(std::ios::eofbit);
+        return false;
     }
-    else if (isdigit(c) || c == '-' || c =='+'){
-        input.putback(c);
+    const std::streamsize available = source.in_avail();
+    if (available > 0) {
+        count += source.sgetn(buffer_.data() + 1, std::min<std::streamsize>(available, BLOCK_SIZE - 1));
+    }
+    begin_ = buffer_.data();
+    end_ = buffer_.data() + count;
+    return true;
+}
+
+bool Reader::HoldsWholeText() const {
+    return input_ == nullptr;
+}
 
-        const auto number = LoadNumber(input);
-        if (holds_alternative<int>(number)) {
-            return Node(get<int>(number));
+bool Reader::SkipWhitespace() {
+    do {
+        begin_ = FindNonWhitespace(begin_, end_);
+        if (begin_ != end_) {
+            return true;
         }
-        else if (holds_alternative<double>(number)) {
-            return Node(get<double>(number));
+    } while (Refill());
+    return false;
+}
+
+bool Reader::SkipLine() {
+    while (Refill()) {
+        const void* line_end = std::memchr(begin_, '\n', end_ - begin_);
+        if (line_end != nullptr) {
+            begin_ = static_cast<const char*>(line_end) + 1;
+            return true;
         }
-        return Node();
+        begin_ = end_;
     }
-    throw ParsingError("Parsing error");
+    return false;
 }
 
-}  // namespace
-
 const Node::Value& Node::GetValue() const {
     return value_;
 }
@@ -473,8 +717,371 @@ bool operator!=(const Document& lhs, const Document& rhs) {
     return !(lhs == rhs);
 }
 
+Document Load(Reader& reader) {
+    return Document{LoadNode(reader)};
+}
+
+Document Load(std::string_view text) {
+    Reader reader(text);
+    return Load(reader);
+}
+
 Document Load(istream& input) {
-    return Document{LoadNode(input)};
+    Reader reader(input);
+    return Load(reader);
+}
+
+void* Arena::Allocate(std::size_t size, std::size_t alignment) {
+    if (size > BLOCK_SIZE / 4) {
+        // new char[] выравнивает блок для любого типа
+        large_blocks_.emplace_back(new char[size]);
+        return large_blocks_.back().get();
+    }
+    std::size_t padding = (alignment - reinterpret_cast<std::uintptr_t>(begin_) % alignment) % alignment;
+    if (static_cast<std::size_t>(end_ - begin_) < padding + size) {
+        if (used_blocks_ == blocks_.size()) {
+            blocks_.emplace_back(new char[BLOCK_SIZE]);
+        }
+        begin_ = blocks_[used_blocks_++].get();
+        end_ = begin_ + BLOCK_SIZE;
+        padding = 0;
+    }
+    void* result = begin_ + padding;
+    begin_ += padding + size;
+    return result;
+}
+
+void Arena::Clear() {
+    large_blocks_.clear();
+    used_blocks_ = 0;
+    begin_ = nullptr;
+    end_ = nullptr;
+}
+
+Arena::Position Arena::GetPosition() const {
+    return {used_blocks_, large_blocks_.size(), begin_, end_};
+}
+
+void Arena::Rollback(const Position& position) {
+    large_blocks_.resize(position.large_blocks);
+    used_blocks_ = position.used_blocks;
+    begin_ = position.begin;
+    end_ = position.end;
+}
+
+ArenaArray::ArenaArray(const ArenaNode* items, std::size_t size)
+    : items_(items)
+    , size_(size) {
+}
+
+const ArenaNode* ArenaArray::begin() const {
+    return items_;
+}
+
+const ArenaNode* ArenaArray::end() const {
+    return items_ + size_;
+}
+
+std::size_t ArenaArray::size() const {
+    return size_;
+}
+
+bool ArenaArray::empty() const {
+    return size_ == 0;
+}
+
+const ArenaNode& ArenaArray::operator[](std::size_t index) const {
+    return items_[index];
+}
+
+const ArenaNode& ArenaArray::at(std::size_t index) const {
+    if (index >= size_) {
+        throw std::out_of_range("Array index out of range");
+    }
+    return items_[index];
+}
+
+ArenaDict::ArenaDict(const ArenaEntry* entries, std::size_t size)
+    : entries_(entries)
+    , size_(size) {
+}
+
+const ArenaEntry* ArenaDict::begin() const {
+    return entries_;
+}
+
+const ArenaEntry* ArenaDict::end() const {
+    return entries_ + size_;
+}
+
+std::size_t ArenaDict::size() const {
+    return size_;
+}
+
+bool ArenaDict::empty() const {
+    return size_ == 0;
+}
+
+const ArenaNode* ArenaDict::Find(std::string_view key) const {
+    for (const ArenaEntry& entry : *this) {
+        if (entry.key.AsString() == key) {
+            return &entry.value;
+        }
+    }
+    return nullptr;
+}
+
+const ArenaNode& ArenaDict::at(std::string_view key) const {
+    const ArenaNode* value = Find(key);
+    if (value == nullptr) {
+        throw std::out_of_range("Key "s + std::string(key) + " not found"s);
+    }
+    return *value;
+}
+
+ArenaNode::ArenaNode(bool value)
+    : type_(Type::BOOL)
+    , bool_(value) {
+}
+
+ArenaNode::ArenaNode(int value)
+    : type_(Type::INT)
+    , int_(value) {
+}
+
+ArenaNode::ArenaNode(double value)
+    : type_(Type::DOUBLE)
+    , double_(value) {
+}
+
+ArenaNode ArenaNode::String(const char* chars, std::size_t size, bool is_escaped) {
+    ArenaNode node;
+    node.type_ = Type::STRING;
+    node.is_escaped_ = is_escaped;
+    node.size_ = static_cast<std::uint32_t>(size);
+    node.chars_ = chars;
+    return node;
+}
+
+ArenaNode ArenaNode::Array(const ArenaNode* items, std::size_t size) {
+    ArenaNode node;
+    node.type_ = Type::ARRAY;
+    node.size_ = static_cast<std::uint32_t>(size);
+    node.items_ = items;
+    return node;
+}
+
+ArenaNode ArenaNode::Dict(const ArenaEntry* entries, std::size_t size) {
+    ArenaNode node;
+    node.type_ = Type::DICT;
+    node.size_ = static_cast<std::uint32_t>(size);
+    node.entries_ = entries;
+    return node;
+}
+
+bool ArenaNode::IsInt() const {
+    return type_ == Type::INT;
+}
+
+//Возвращает true, если в узле хранится int либо double.
+bool ArenaNode::IsDouble() const {
+    return type_ == Type::DOUBLE || IsInt();
+}
+
+//Возвращает true, если в узле хранится double.
+bool ArenaNode::IsPureDouble() const {
+    return type_ == Type::DOUBLE;
+}
+
+bool ArenaNode::IsBool() const {
+    return type_ == Type::BOOL;
+}
+
+bool ArenaNode::IsString() const {
+    return type_ == Type::STRING;
+}
+
+bool ArenaNode::IsNull() const {
+    return type_ == Type::NULL_VALUE;
+}
+
+bool ArenaNode::IsArray() const {
+    return type_ == Type::ARRAY;
+}
+
+bool ArenaNode::IsMap() const {
+    return type_ == Type::DICT;
+}
+
+int ArenaNode::AsInt() const {
+    if (!IsInt()) {
+        throw std::logic_error("");
+    }
+    return int_;
+}
+
+bool ArenaNode::AsBool() const {
+    if (!IsBool()) {
+        throw std::logic_error("");
+    }
+    return bool_;
+}
+
+//Возвращает значение типа double, если внутри хранится double либо int.
+double ArenaNode::AsDouble() const {
+    if (!IsDouble()) {
+        throw std::logic_error("");
+    }
+    if (IsInt()) {
+        return int_;
+    }
+    return double_;
+}
+
+//Строка с escape-последовательностями лежит в арене и раскрывается на месте при первом обращении
+std::string_view ArenaNode::AsString() const {
+    if (!IsString()) {
+        throw std::logic_error("");
+    }
+    if (is_escaped_) {
+        size_ = static_cast<std::uint32_t>(UnescapeInPlace(const_cast<char*>(chars_), size_));
+        is_escaped_ = false;
+    }
+    return {chars_, size_};
+}
+
+ArenaArray ArenaNode::AsArray() const {
+    if (!IsArray()) {
+        throw std::logic_error("");
+    }
+    return {items_, size_};
+}
+
+ArenaDict ArenaNode::AsMap() const {
+    if (!IsMap()) {
+        throw std::logic_error("");
+    }
+    return {entries_, size_};
+}
+
+const ArenaNode& ArenaDocument::Load(Reader& reader) {
+    last_position_ = arena_.GetPosition();
+    ArenaNode* root = arena_.Allocate<ArenaNode>(1);
+    return *new (root) ArenaNode(LoadNode(reader));
+}
+
+const ArenaNode& ArenaDocument::Load(std::string_view text) {
+    Reader reader(text);
+    return Load(reader);
+}
+
+void ArenaDocument::Clear() {
+    arena_.Clear();
+    last_position_ = arena_.GetPosition();
+}
+
+void ArenaDocument::ReleaseLast() {
+    arena_.Rollback(last_position_);
+}
+
+// Элементы массива и словаря собираются в items_ и entries_ и по окончании разбора
+// переносятся в арену одним участком: вложенные значения к этому времени уже сняты со стека
+ArenaNode ArenaDocument::LoadNode(Reader& reader) {
+    const int c = GetAfterWhitespace(reader);
+    if (c == '[') {
+        const std::size_t first = items_.size();
+        LoadArrayItems(reader, [this, &reader] {
+            ArenaNode item = LoadNode(reader);
+            items_.push_back(item);
+        });
+        const std::size_t size = items_.size() - first;
+        ArenaNode* items = arena_.Allocate<ArenaNode>(size);
+        std::copy(items_.begin() + first, items_.end(), items);
+        items_.resize(first);
+        return ArenaNode::Array(items, size);
+    } else if (c == '{') {
+        const std::size_t first = entries_.size();
+        LoadDictItems(reader, [this, &reader] {
+            return LoadString(reader);
+        }, [this, &reader](ArenaNode key) {
+            ArenaNode value = LoadNode(reader);
+            entries_.push_back({key, value});
+        });
+        const std::size_t size = entries_.size() - first;
+        ArenaEntry* entries = arena_.Allocate<ArenaEntry>(size);
+        std::copy(entries_.begin() + first, entries_.end(), entries);
+        entries_.resize(first);
+        return ArenaNode::Dict(entries, size);
+    } else if (c == '"') {
+        return LoadString(reader);
+    }
+    const Node scalar = LoadScalar(reader, c);
+    if (scalar.IsBool()) {
+        return ArenaNode(scalar.AsBool());
+    }
+    if (scalar.IsInt()) {
+        return ArenaNode(scalar.AsInt());
+    }
+    if (scalar.IsPureDouble()) {
+        return ArenaNode(scalar.AsDouble());
+    }
+    return ArenaNode();
+}
+
+// Считывает строковый литерал после открывающей кавычки, не раскрывая escape-последовательности
+ArenaNode ArenaDocument::LoadString(Reader& reader) {
+    bool is_escaped = false;
+    bool is_after_backslash = false;
+    const char* begin = reader.Begin();
+    const char* end = FindStringEnd(begin, reader.End(), is_escaped, is_after_backslash);
+    if (end != reader.End()) {
+        reader.Advance(end - begin + 1);
+        // Текст в памяти существует, пока используются узлы, и строку без escape-последовательностей
+        // можно не копировать
+        if (reader.HoldsWholeText() && !is_escaped) {
+            return ArenaNode::String(begin, end - begin, false);
+        }
+        return CopyString(begin, end - begin, is_escaped);
+    }
+    // Строка продолжается за концом буфера и собирается по частям
+    chars_.assign(begin, end);
+    reader.Advance(end - begin);
+    while (true) {
+        if (!reader.Refill()) {
+            throw ParsingError("String parsing error");
+        }
+        begin = reader.Begin();
+        end = FindStringEnd(begin, reader.End(), is_escaped, is_after_backslash);
+        chars_.append(begin, end);
+        if (end != reader.End()) {
+            reader.Advance(end - begin + 1);
+            return CopyString(chars_.data(), chars_.size(), is_escaped);
+        }
+        reader.Advance(end - begin);
+    }
+}
+
+ArenaNode ArenaDocument::CopyString(const char* chars, std::size_t size, bool is_escaped) {
+    char* copy = arena_.Allocate<char>(size);
+    std::memcpy(copy, chars, size);
+    return ArenaNode::String(copy, size, is_escaped);
+}
+
+ArenaDocument* Handler::GetValueDocument() {
+    return nullptr;
+}
+
+void Handler::Value(const ArenaNode&) {
+    throw std::logic_error("Handler does not accept arena values");
+}
+
+void Parse(Reader& reader, Handler& handler) {
+    ParseNode(reader, handler);
+}
+
+void Parse(istream& input, Handler& handler) {
+    Reader reader(input);
+    Parse(reader, handler);
 }
 
 void Print(const Document& doc, std::ostream& output) {
@@ -1,12 +1,16 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <variant>
 #include <regex>
 #include <algorithm>
+#include <type_traits>
 
 namespace json {
 
@@ -22,19 +26,6 @@ public:
     using runtime_error::runtime_error;
 };
 
-void DeletePrefix(std::istream& input);
-
-//Проверка на равенство слова из потока
-bool CheckWord(const std::string& std, std::istream& input) ;
-
-using Number = std::variant<int, double>;
-
-Number LoadNumber(std::istream& input);
-
-// Считывает содержимое строкового литерала JSON-документа
-// Функцию следует иexспользовать после считывания открывающего символа ":
-std::string LoadString(std::istream& input);
-
 class Node {
 public:
 
@@ -43,8 +34,8 @@ public:
     Node() = default;
 
     template <typename Value>
-    Node(Value value) {
-        value_ = value;
+    Node(Value value)
+        : value_(std::move(value)) {
     }
 
 
@@ -115,8 +106,252 @@ private:
 bool operator==(const Document& lhs, const Document& rhs);
 bool operator!=(const Document& lhs, const Document& rhs);
 
+// Источник текста для разбора JSON: непрерывный буфер в памяти либо поток, который читается
+// блоками до BLOCK_SIZE символов. Разбор идёт прямо по буферу, без посимвольных вызовов istream
+class Reader {
+public:
+    static constexpr std::size_t BLOCK_SIZE = 1 << 16;
+
+    // Текст должен существовать, пока идёт разбор
+    explicit Reader(std::string_view text);
+    // Из потока может быть прочитано больше, чем занимает один документ, поэтому несколько
+    // документов из одного потока читаются через один и тот же Reader
+    explicit Reader(std::istream& input);
+
+    // Непрочитанная часть буфера
+    const char* Begin() const;
+    const char* End() const;
+    void Advance(std::ptrdiff_t count);
+
+    // Если буфер прочитан целиком, дочитывает в него очередной блок из потока.
+    // Ждёт хотя бы один символ, но не ждёт заполнения всего блока.
+    // Возвращает false, если данных больше нет
+    bool Refill();
+
+    // Пропускает пробельные символы; false, если данных больше нет
+    bool SkipWhitespace();
+
+    // Пропускает остаток строки вместе с '\n'; false, если данных больше нет
+    bool SkipLine();
+
+    // Весь текст в памяти вызывающего, и разобранные значения могут ссылаться на него
+    bool HoldsWholeText() const;
+
+private:
+    std::istream* input_ = nullptr;
+    std::vector<char> buffer_;
+    const char* begin_ = nullptr;
+    const char* end_ = nullptr;
+};
+
+// Область памяти, из которой объекты выделяются сдвигом указателя внутри блоков по BLOCK_SIZE байт.
+// Отдельные объекты не освобождаются: память отдаётся только вся сразу
+class Arena {
+public:
+    static constexpr std::size_t BLOCK_SIZE = 1 << 16;
+
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* Allocate(std::size_t size, std::size_t alignment);
+
+    // Память под count объектов T; объекты не разрушаются, поэтому деструктор T должен быть тривиальным
+    template <typename T>
+    T* Allocate(std::size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>);
+        return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    // Освобождает всё выделенное. Блоки BLOCK_SIZE остаются для следующих выделений
+    void Clear();
+
+    // Состояние арены, к которому можно вернуться, освободив всё выделенное после него
+    struct Position {
+        std::size_t used_blocks = 0;
+        std::size_t large_blocks = 0;
+        char* begin = nullptr;
+        char* end = nullptr;
+    };
+
+    Position GetPosition() const;
+    void Rollback(const Position& position);
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    // Блоки под выделения больше четверти BLOCK_SIZE, освобождаются в Clear
+    std::vector<std::unique_ptr<char[]>> large_blocks_;
+    // Число блоков из blocks_, в которых уже выделялась память
+    std::size_t used_blocks_ = 0;
+    // Свободная часть текущего блока
+    char* begin_ = nullptr;
+    char* end_ = nullptr;
+};
+
+class ArenaNode;
+struct ArenaEntry;
+
+// Элементы массива ArenaNode
+class ArenaArray {
+public:
+    ArenaArray(const ArenaNode* items, std::size_t size);
+
+    const ArenaNode* begin() const;
+    const ArenaNode* end() const;
+    std::size_t size() const;
+    bool empty() const;
+
+    const ArenaNode& operator[](std::size_t index) const;
+    const ArenaNode& at(std::size_t index) const;
+
+private:
+    const ArenaNode* items_;
+    std::size_t size_;
+};
+
+// Элементы словаря ArenaNode в порядке входного документа. Ключ ищется перебором: в словарях
+// запросов по несколько ключей. При повторе ключа находится первое значение, как в Dict
+class ArenaDict {
+public:
+    ArenaDict(const ArenaEntry* entries, std::size_t size);
+
+    const ArenaEntry* begin() const;
+    const ArenaEntry* end() const;
+    std::size_t size() const;
+    bool empty() const;
+
+    // Значение по ключу или nullptr
+    const ArenaNode* Find(std::string_view key) const;
+    const ArenaNode& at(std::string_view key) const;
+
+private:
+    const ArenaEntry* entries_;
+    std::size_t size_;
+};
+
+// Узел ArenaDocument. Элементы массивов и словарей лежат в арене документа, строки ссылаются
+// на входной текст либо на его копию в арене. Строка с escape-последовательностями хранится
+// как записана во входном тексте и раскрывается на месте при первом AsString, поэтому одну
+// такую строку нельзя читать из нескольких потоков одновременно
+class ArenaNode {
+public:
+    ArenaNode() = default;
+    explicit ArenaNode(bool value);
+    explicit ArenaNode(int value);
+    explicit ArenaNode(double value);
+
+    // Строка из size символов по адресу chars; is_escaped — в ней есть escape-последовательности,
+    // тогда chars должен указывать на изменяемую память
+    static ArenaNode String(const char* chars, std::size_t size, bool is_escaped);
+    static ArenaNode Array(const ArenaNode* items, std::size_t size);
+    static ArenaNode Dict(const ArenaEntry* entries, std::size_t size);
+
+    bool IsInt() const;
+    bool IsDouble() const; //Возвращает true, если в узле хранится int либо double.
+    bool IsPureDouble() const; //Возвращает true, если в узле хранится double.
+    bool IsBool() const;
+    bool IsString() const;
+    bool IsNull() const;
+    bool IsArray() const;
+    bool IsMap() const;
+
+    int AsInt() const;
+    bool AsBool() const;
+    double AsDouble() const; //Возвращает значение типа double, если внутри хранится double либо int.
+    std::string_view AsString() const;
+    ArenaArray AsArray() const;
+    ArenaDict AsMap() const;
+
+private:
+    enum class Type : std::uint8_t {
+        NULL_VALUE,
+        BOOL,
+        INT,
+        DOUBLE,
+        STRING,
+        ARRAY,
+        DICT
+    };
+
+    Type type_ = Type::NULL_VALUE;
+    mutable bool is_escaped_ = false;
+    // Число символов строки либо элементов массива или словаря
+    mutable std::uint32_t size_ = 0;
+    union {
+        const char* chars_ = nullptr;
+        bool bool_;
+        int int_;
+        double double_;
+        const ArenaNode* items_;
+        const ArenaEntry* entries_;
+    };
+};
+
+struct ArenaEntry {
+    ArenaNode key;
+    ArenaNode value;
+};
+
+// JSON-документ, узлы которого размещены в одной арене. В документ можно загрузить несколько
+// значений подряд; все они освобождаются разом в Clear или деструкторе. Строки без
+// escape-последовательностей из Reader над текстом в памяти ссылаются на этот текст, и он должен
+// существовать, пока используются узлы. Остальные строки копируются в арену
+class ArenaDocument {
+public:
+    // Разбирает очередное значение из reader в документ
+    const ArenaNode& Load(Reader& reader);
+    const ArenaNode& Load(std::string_view text);
+
+    void Clear();
+
+    // Освобождает значение, загруженное последним; ссылки на его узлы становятся недействительными
+    void ReleaseLast();
+
+private:
+    Arena arena_;
+    // Состояние арены перед загрузкой последнего значения
+    Arena::Position last_position_;
+    // Элементы массивов и словарей, разбор которых ещё не закончен
+    std::vector<ArenaNode> items_;
+    std::vector<ArenaEntry> entries_;
+    // Строка, которая продолжается за концом блока Reader
+    std::string chars_;
+
+    ArenaNode LoadNode(Reader& reader);
+    ArenaNode LoadString(Reader& reader);
+    ArenaNode CopyString(const char* chars, std::size_t size, bool is_escaped);
+};
+
+Document Load(Reader& reader);
+Document Load(std::string_view text);
+// Поток может быть прочитан дальше конца документа
 Document Load(std::istream& input);
 
+// Получатель событий потокового разбора JSON-документа. Ключи словарей приходят через Key,
+// значения null, bool, чисел и строк — через Value
+class Handler {
+public:
+    virtual void StartDict() = 0;
+    virtual void EndDict() = 0;
+    virtual void StartArray() = 0;
+    virtual void EndArray() = 0;
+    virtual void Key(std::string key) = 0;
+    virtual void Value(Node value) = 0;
+
+    // Документ, в который очередное значение разбирается целиком: о нём сообщается одним вызовом
+    // Value(const ArenaNode&) вместо событий о его элементах. nullptr — значение передаётся событиями
+    virtual ArenaDocument* GetValueDocument();
+    virtual void Value(const ArenaNode& value);
+
+protected:
+    ~Handler() = default;
+};
+
+// Разбирает один JSON-документ из input, не строя дерево Node: о каждом элементе
+// сообщается handler в порядке следования во входном потоке
+void Parse(Reader& reader, Handler& handler);
+void Parse(std::istream& input, Handler& handler);
+
 void Print(const Document& doc, std::ostream& output);
 
 }  // namespace json
@@ -3,8 +3,15 @@
 #include "serialization.h"
 #include "request_handler.h"
 #include "map_renderer.h"
+#include "json_writer.h"
 
-#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <optional>
+#include <mutex>
+#include <thread>
 
 using namespace std::literals;
 
@@ -12,23 +19,115 @@ JsonReader::JsonReader(TransportCatalogue db)
     : db_(db) {
 }
 
-//Загрузка данных в транспортный каталог
+//Загрузка данных в транспортный каталог и запись базы. После расчёта расстояний и статистики
+//маршрутов каталог больше не меняется, и этапы независимы: карта отрисовывается, каталог
+//кодируется в пуле потоков, а маршрутизатор строится одновременно с ними в этом потоке.
+//Каждый этап дописывает в файл базы свои секции, как только они готовы
 void JsonReader::LoadData() {
-    for (const auto& request : base_requests_) {
-        if (request.AsMap().at("type").AsString() == "Stop") {
-            ParsingStop(request.AsMap());
-        }
+    if (read_error_) {
+        std::rethrow_exception(read_error_);
     }
-    for (const auto& request : base_requests_) {
-        if (request.AsMap().at("type").AsString() == "Bus") {
-                    ParsingBus(request.AsMap());
+    std::ostream* timings_output = GetTimingsOutput();
+    {
+        LogDuration timer("load buses and distances", timings_output);
+        //Остановки добавлены в каталог при чтении
+        for (const json::ArenaNode* request : base_requests_) {
+            ParsingBus(request->AsMap());
         }
+        base_requests_.clear();
+        requests_document_.Clear();
+        db_.DistanceAdd();
     }
-    db_.DistanceAdd();
-    trans_router_ = std::make_unique<TransportRouter>(routing_settings_.at("bus_wait_time").AsInt(), routing_settings_.at("bus_velocity").AsInt(), db_);
+    {
+        LogDuration timer("compute bus stats", timings_output);
+        ComputeBusInfos();
+    }
+
+    //Настройки читаются до запуска этапов, чтобы ошибка в них не оставляла недописанную базу
+    const int bus_wait_time = routing_settings_.at("bus_wait_time").AsInt();
+    const int bus_velocity = routing_settings_.at("bus_velocity").AsInt();
+    const RouterType router_type = GetRouterType();
+    const GraphModel graph_model = GetGraphModel();
+    const size_t route_cache_size = GetRouteCacheSize();
     map_render_ = std::make_unique<renderer::MapRenderer>(GetRenderSettings());
-    proto_info::ProtoInfo serializator(db_, *map_render_ , *trans_router_);
-    serializator.Serialization(serialization_settings_.at("file").AsString());
+
+    proto_info::ProtoInfo serializator;
+    serializator.BeginSerialization(serialization_settings_.at("file").AsString());
+    const std::vector<std::function<void()>> stages = {
+        [&] {
+            LogDuration timer("render map", timings_output);
+            //Справочник больше не меняется, поэтому карта отрисовывается один раз и сохраняется в базе
+            map_render_->SetSvg(RenderMap());
+            serializator.WriteMap(*map_render_);
+        },
+        [&] {
+            LogDuration timer("encode catalogue", timings_output);
+            serializator.WriteCatalogue(db_);
+            serializator.WriteBusStats(db_);
+        },
+    };
+    //Маршрутизатор строится в этом потоке и раздаёт свою работу тому же пулу: в задаче пула
+    //он ждал бы задачи, стоящие в очереди за ним, и мог бы занять все потоки пула
+    ThreadPool* thread_pool = GetThreadPool();
+    std::vector<std::future<void>> stage_results;
+    if (thread_pool != nullptr) {
+        for (const auto& stage : stages) {
+            stage_results.push_back(thread_pool->Submit(stage));
+        }
+    }
+    //Этапы в пуле ссылаются на локальные переменные, поэтому их ждут и при ошибке
+    std::exception_ptr error;
+    //Без пула маршрутизатор строится первым: его временные данные освобождаются до отрисовки карты
+    try {
+        {
+            LogDuration timer("build router", timings_output);
+            auto trans_router = std::make_unique<TransportRouter>(bus_wait_time, bus_velocity, db_,
+                                                                  router_type, graph_model, thread_pool);
+            trans_router->SetRouteCacheSize(route_cache_size);
+            serializator.WriteRouter(*trans_router);
+            trans_router_ = std::move(trans_router);
+        }
+        if (thread_pool == nullptr) {
+            for (const auto& stage : stages) {
+                stage();
+            }
+        }
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    for (auto& result : stage_results) {
+        result.wait();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    for (auto& result : stage_results) {
+        result.get();
+    }
+    serializator.EndSerialization();
+}
+
+void JsonReader::ComputeBusInfos() {
+    const std::deque<Bus>& buses = db_.GetBuses();
+    std::vector<BusInfo> bus_infos(buses.size());
+    auto compute_chunk = [this, &buses, &bus_infos](size_t chunk) {
+        const size_t end = std::min(buses.size(), (chunk + 1) * BUSES_CHUNK_SIZE);
+        for (size_t bus_id = chunk * BUSES_CHUNK_SIZE; bus_id < end; ++bus_id) {
+            bus_infos[bus_id] = db_.ComputeBusInfo(buses[bus_id]);
+        }
+    };
+    const size_t chunk_count = (buses.size() + BUSES_CHUNK_SIZE - 1) / BUSES_CHUNK_SIZE;
+    ThreadPool* thread_pool = GetThreadPool();
+    if (thread_pool != nullptr) {
+        thread_pool->ParallelFor(chunk_count, compute_chunk);
+    }
+    else {
+        for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+            compute_chunk(chunk);
+        }
+    }
+    db_.SetBusInfos(std::move(bus_infos));
 }
 
 //Чтение цвета из Node
@@ -61,6 +160,69 @@ svg::Color JsonReader::GetColorFromNode(json::Node& color) {
     throw json::ParsingError("Failed to read color");
 }
 
+//Получение типа маршрутизатора из routing_settings
+RouterType JsonReader::GetRouterType() const {
+    const auto router_type = routing_settings_.find("router_type");
+    if (router_type == routing_settings_.end() || router_type->second.AsString() == "all_pairs") {
+        return RouterType::ALL_PAIRS;
+    }
+    if (router_type->second.AsString() == "dijkstra") {
+        return RouterType::DIJKSTRA;
+    }
+    if (router_type->second.AsString() == "contraction_hierarchies") {
+        return RouterType::CONTRACTION_HIERARCHIES;
+    }
+    throw json::ParsingError("Failed to read router type");
+}
+
+//Получение модели графа маршрутов из routing_settings
+GraphModel JsonReader::GetGraphModel() const {
+    const auto graph_model = routing_settings_.find("graph_model");
+    if (graph_model == routing_settings_.end() || graph_model->second.AsString() == "stop_pairs") {
+        return GraphModel::STOP_PAIRS;
+    }
+    if (graph_model->second.AsString() == "bus_chains") {
+        return GraphModel::BUS_CHAINS;
+    }
+    throw json::ParsingError("Failed to read graph model");
+}
+
+//Получение размера кеша маршрутов из routing_settings
+size_t JsonReader::GetRouteCacheSize() const {
+    const auto route_cache_size = routing_settings_.find("route_cache_size");
+    if (route_cache_size == routing_settings_.end()) {
+        return 0;
+    }
+    if (route_cache_size->second.AsInt() < 0) {
+        throw json::ParsingError("Failed to read route cache size");
+    }
+    return route_cache_size->second.AsInt();
+}
+
+//Получение числа потоков для ответов на запросы из execution_settings, 0 — по числу аппаратных потоков
+size_t JsonReader::GetThreadCount() const {
+    const auto thread_count = execution_settings_.find("thread_count");
+    if (thread_count == execution_settings_.end()) {
+        return 0;
+    }
+    if (thread_count->second.AsInt() < 0) {
+        throw json::ParsingError("Failed to read thread count");
+    }
+    return thread_count->second.AsInt();
+}
+
+//Время этапов выводится в stderr, чтобы не смешиваться с ответами
+std::ostream* JsonReader::GetTimingsOutput() const {
+    const auto print_timings = execution_settings_.find("print_timings");
+    if (print_timings == execution_settings_.end()) {
+        return nullptr;
+    }
+    if (!print_timings->second.IsBool()) {
+        throw json::ParsingError("Failed to read print timings");
+    }
+    return print_timings->second.AsBool() ? &std::cerr : nullptr;
+}
+
 //Получение данных для вывод карты
 renderer::RenderSettings JsonReader::GetRenderSettings() {
     renderer::RenderSettings render_settings;
@@ -88,29 +250,211 @@ renderer::RenderSettings JsonReader::GetRenderSettings() {
     return render_settings;
 }
 
-//Чтение Json и определение base_requests_ и stat_requests_
-void JsonReader::ReadJson(std::istream& input, std::string_view mode) {
-    json::Document read_data = json::Load(input);
-    const auto& parameters = read_data.GetRoot().AsMap();
-    if (mode == "make_base") {
-        base_requests_ = parameters.at("base_requests").AsArray();
-        render_settings_ = parameters.at("render_settings").AsMap();
-        routing_settings_ = parameters.at("routing_settings").AsMap();
+//Потоковый разбор входного документа. Элементы base_requests и stat_requests разбираются
+//по одному в арену запросов и сразу передаются JsonReader, значения остальных ключей
+//верхнего уровня собираются в Node целиком.
+//Ошибка обработки запоминается, а документ дочитывается до конца, чтобы поток остался
+//на границе документов
+class JsonReader::InputHandler final : public json::Handler {
+public:
+    explicit InputHandler(JsonReader& reader)
+        : reader_(reader) {
+    }
+
+    void StartDict() override {
+        StartContainer(true);
+    }
+
+    void EndDict() override {
+        EndContainer(true);
+    }
+
+    void StartArray() override {
+        StartContainer(false);
+    }
 
+    void EndArray() override {
+        EndContainer(false);
     }
-    else if (mode == "process_requests") {
-        stat_requests_ = parameters.at("stat_requests").AsArray();
+
+    void Key(std::string key) override {
+        if (depth_ == 1) {
+            key_ = std::move(key);
+        }
+        else {
+            builder_->Key(std::move(key));
+        }
+    }
+
+    void Value(json::Node value) override {
+        if (depth_ == 0) {
+            throw json::ParsingError("Input document must be a dict");
+        }
+        if (builder_) {
+            builder_->Value(std::move(value));
+        }
+        else {
+            Complete(std::move(value));
+        }
+    }
+
+    json::ArenaDocument* GetValueDocument() override {
+        return is_requests_array_ && depth_ == 2 ? &reader_.requests_document_ : nullptr;
     }
-    serialization_settings_ = parameters.at("serialization_settings").AsMap();
+
+    void Value(const json::ArenaNode& request) override {
+        if (reader_.read_error_) {
+            return;
+        }
+        try {
+            reader_.ReadRequest(key_, request);
+        }
+        catch (...) {
+            reader_.read_error_ = std::current_exception();
+        }
+    }
+
+private:
+    JsonReader& reader_;
+    //Число открытых словарей и массивов
+    size_t depth_ = 0;
+    //Текущий ключ верхнего уровня
+    std::string key_;
+    //Разбирается массив base_requests или stat_requests
+    bool is_requests_array_ = false;
+    //Собираемое значение ключа верхнего уровня
+    std::optional<json::Builder> builder_;
+
+    void StartContainer(bool is_dict) {
+        if (depth_ == 0 && !is_dict) {
+            throw json::ParsingError("Input document must be a dict");
+        }
+        if (depth_ == 1 && !is_dict && (key_ == "base_requests" || key_ == "stat_requests")) {
+            is_requests_array_ = true;
+        }
+        else if (depth_ > 0) {
+            if (!builder_) {
+                builder_.emplace();
+            }
+            if (is_dict) {
+                builder_->StartDict();
+            }
+            else {
+                builder_->StartArray();
+            }
+        }
+        ++depth_;
+    }
+
+    void EndContainer(bool is_dict) {
+        --depth_;
+        if (depth_ == 0) {
+            return;
+        }
+        if (depth_ == 1 && is_requests_array_) {
+            is_requests_array_ = false;
+            return;
+        }
+        if (is_dict) {
+            builder_->EndDict();
+        }
+        else {
+            builder_->EndArray();
+        }
+        if (depth_ == 1) {
+            json::Node value = builder_->Build();
+            builder_.reset();
+            Complete(std::move(value));
+        }
+    }
+
+    //Значение ключа верхнего уровня прочитано целиком
+    void Complete(json::Node value) {
+        if (reader_.read_error_) {
+            return;
+        }
+        try {
+            reader_.ReadSetting(key_, std::move(value));
+        }
+        catch (...) {
+            reader_.read_error_ = std::current_exception();
+        }
+    }
+};
+
+//Потоковое чтение Json
+void JsonReader::ReadJson(std::istream& input, std::string_view mode) {
+    json::Reader reader(input);
+    ReadJson(reader, mode);
 }
 
+void JsonReader::ReadJson(json::Reader& input, std::string_view mode) {
+    mode_ = mode;
+    base_requests_.clear();
+    stat_requests_.clear();
+    requests_document_.Clear();
+    response_text_ = mode == "process_requests" ? "["s : ""s;
+    has_responses_ = false;
+    is_output_flushed_ = false;
+    execution_settings_.clear();
+    is_base_ready_ = false;
+    read_error_ = nullptr;
+
+    InputHandler handler(*this);
+    json::Parse(input, handler);
+}
 
+//Ключ верхнего уровня входного документа, кроме base_requests и stat_requests
+void JsonReader::ReadSetting(const std::string& key, json::Node value) {
+    if (key == "render_settings") {
+        render_settings_ = value.AsMap();
+    }
+    else if (key == "routing_settings") {
+        routing_settings_ = value.AsMap();
+    }
+    else if (key == "execution_settings") {
+        execution_settings_ = value.AsMap();
+    }
+    else if (key == "serialization_settings") {
+        serialization_settings_ = value.AsMap();
+        if (mode_ == "process_requests") {
+            EnsureBaseLoaded();
+            is_base_ready_ = true;
+            if (stat_requests_.size() >= STAT_REQUESTS_BATCH_SIZE) {
+                AnswerStatRequests();
+            }
+        }
+    }
+}
+
+//Очередной элемент массива base_requests или stat_requests
+void JsonReader::ReadRequest(const std::string& key, const json::ArenaNode& request) {
+    if (mode_ == "make_base" && key == "base_requests") {
+        const std::string_view type = request.AsMap().at("type").AsString();
+        if (type == "Bus") {
+            base_requests_.push_back(&request);
+            return;
+        }
+        if (type == "Stop") {
+            ParsingStop(request.AsMap());
+        }
+    }
+    else if (mode_ == "process_requests" && key == "stat_requests") {
+        stat_requests_.push_back(&request);
+        if (is_base_ready_ && stat_requests_.size() >= STAT_REQUESTS_BATCH_SIZE) {
+            AnswerStatRequests();
+        }
+        return;
+    }
+    //Запрос больше не нужен, а его узлы — последнее, что разобрано в арену
+    requests_document_.ReleaseLast();
+}
 
 //Обработка запроса на добавления остановки
-void JsonReader::ParsingStop(const json::Dict& stop_info) {
+void JsonReader::ParsingStop(const json::ArenaDict& stop_info) {
     Stop stop;
 
-    stop.stopname = stop_info.at("name").AsString();
+    stop.stopname = std::string(stop_info.at("name").AsString());
 
     stop.coordinates.lat = stop_info.at("latitude").AsDouble();
     stop.coordinates.lng = stop_info.at("longitude").AsDouble();
@@ -121,11 +465,11 @@ void JsonReader::ParsingStop(const json::Dict& stop_info) {
 }
 
 //Обработка запроса на добавления остановки
-void JsonReader::ParsingBus(const json::Dict& bus_info) {
+void JsonReader::ParsingBus(const json::ArenaDict& bus_info) {
     std::vector<std::string> stopnames;
 
-    for (auto stopname : bus_info.at("stops").AsArray()) {
-        stopnames.push_back(stopname.AsString());
+    for (const json::ArenaNode& stopname : bus_info.at("stops").AsArray()) {
+        stopnames.emplace_back(stopname.AsString());
     }
 
     if (!bus_info.at("is_roundtrip").AsBool()) {
@@ -139,76 +483,73 @@ void JsonReader::ParsingBus(const json::Dict& bus_info) {
     db_.AddBus(bus_info.at("name").AsString(), stopnames, bus_info.at("is_roundtrip").AsBool());
 }
 
-const DistancesToStops JsonReader::DictStrNodeToStrInt(const json::Dict& distances_node) {
+//При повторе остановки берётся первое расстояние, как при чтении в Dict
+const DistancesToStops JsonReader::DictStrNodeToStrInt(const json::ArenaDict& distances_node) {
     DistancesToStops distances_to_stops;
     for (const auto& [stop, distances] : distances_node) {
-        distances_to_stops[stop] = distances.AsInt();
+        distances_to_stops.emplace(stop.AsString(), distances.AsInt());
     }
     return distances_to_stops;
 }
 
-//Обработка запроса об остановке
-void JsonReader::ProcessStopRequest(const json::Dict& stop_request) {
+//Обработка запроса об остановке. Ключи словаря ответа записываются в алфавитном порядке
+void JsonReader::ProcessStopRequest(const json::ArenaDict& stop_request, json::Writer& response) const {
     StopInfo stop_info = db_.GetStopInfo(stop_request.at("name").AsString());
-    json::Builder response;
     response.StartDict();
 
-    response.Key("request_id").Value(stop_request.at("id").AsInt());
-
     if (stop_info.is_found) {
         response.Key("buses").StartArray();
         for (auto bus : stop_info.buses) {
-            response.Value(json::Node{static_cast<std::string>(bus)});
+            response.Value(bus);
         }
         response.EndArray();
     }
     else {
         response.Key("error_message").Value("not found");
     }
+    response.Key("request_id").Value(stop_request.at("id").AsInt());
+
     response.EndDict();
-    response_array_.Value(response.Build());
 }
 
 //Обработка запроса о маршруте
-void JsonReader::ProcessBusRequest(const json::Dict& bus_request) {
+void JsonReader::ProcessBusRequest(const json::ArenaDict& bus_request, json::Writer& response) const {
     BusInfo bus_info = db_.GetBusInfo(bus_request.at("name").AsString());
-    json::Builder response;
     response.StartDict();
-    response.Key("request_id").Value(bus_request.at("id").AsInt());
     if (bus_info.is_found) {
-        response.Key("curvature").Value(json::Node{bus_info.curvature});
-        response.Key("route_length").Value(json::Node{bus_info.route_len});
-        response.Key("stop_count").Value(json::Node{int(bus_info.stops_count)});
-        response.Key("unique_stop_count").Value(json::Node{int(bus_info.uniq_stops_count)});
+        response.Key("curvature").Value(bus_info.curvature);
+        response.Key("request_id").Value(bus_request.at("id").AsInt());
+        response.Key("route_length").Value(bus_info.route_len);
+        response.Key("stop_count").Value(int(bus_info.stops_count));
+        response.Key("unique_stop_count").Value(int(bus_info.uniq_stops_count));
     }
     else {
         response.Key("error_message").Value("not found");
+        response.Key("request_id").Value(bus_request.at("id").AsInt());
     }
 
     response.EndDict();
-    response_array_.Value(response.Build());
 }
 
-json::Node JsonReader::RouteInfoToJson(const std::vector<EdgeInfo>& edge_info) const {
-    json::Builder json_info;
-    json_info.StartArray();
+void JsonReader::WriteRouteItems(const std::vector<EdgeInfo>& edge_info, json::Writer& response) const {
+    response.StartArray();
 
     for(const auto& info : edge_info) {
         switch (info.type) {
         case EdgeType::WAIT:
-            json_info.StartDict();
-            json_info.Key("type").Value("Wait"s);
-            json_info.Key("stop_name").Value(std::string(info.name));
-            json_info.Key("time").Value(info.time);
-            json_info.EndDict();
+            response.StartDict();
+            response.Key("stop_name").Value(db_.GetStops()[info.id].stopname);
+            response.Key("time").Value(info.time);
+            response.Key("type").Value("Wait");
+            response.EndDict();
             break;
         case EdgeType::BUS_T:
-            json_info.StartDict();
-            json_info.Key("type").Value("Bus"s);
-            json_info.Key("bus").Value(std::string(info.name));
-            json_info.Key("span_count").Value(info.span_count);
-            json_info.Key("time").Value(info.time);
-            json_info.EndDict();
+            response.StartDict();
+            response.Key("bus").Value(db_.GetBuses()[info.id].busname);
+            response.Key("span_count").Value(info.span_count);
+            response.Key("time").Value(info.time);
+            response.Key("type").Value("Bus");
+            response.EndDict();
             break;
         default:
             throw std::runtime_error("Error edge type");
@@ -216,100 +557,422 @@ json::Node JsonReader::RouteInfoToJson(const std::vector<EdgeInfo>& edge_info) c
         }
     }
 
-    json_info.EndArray();
-    return json_info.Build();
+    response.EndArray();
 }
 
 //Обработка запроса о построении маршрута
-void JsonReader::ProcessRoute(const json::Dict& route_request) {
+void JsonReader::ProcessRoute(const json::ArenaDict& route_request, json::Writer& response) const {
+    const PairStops stop_ids{trans_router_->GetStopId(route_request.at("from").AsString()),
+                               trans_router_->GetStopId(route_request.at("to").AsString())};
+    const std::optional<RouteInfo> info = FindRoute(stop_ids);
 
-    auto info = trans_router_->SearchRoute(route_request.at("from").AsString(), route_request.at("to").AsString());
-    json::Builder response;
     response.StartDict();
-    response.Key("request_id").Value(route_request.at("id").AsInt());
-
     if (info == std::nullopt) {
-        response.Key("error_message").Value("not found"s);
+        response.Key("error_message").Value("not found");
+        response.Key("request_id").Value(route_request.at("id").AsInt());
     }
     else {
-        response.Key("items").Value(RouteInfoToJson(info->edge_info));
+        response.Key("items");
+        WriteRouteItems(info->edge_info, response);
+        response.Key("request_id").Value(route_request.at("id").AsInt());
         response.Key("total_time").Value(info->time);
     }
-
     response.EndDict();
-    response_array_.Value(response.Build());
 }
 
-//Обработка запроса о отрисовки карты
-void JsonReader::ProcessRenderMap(int req_id) {
-    json::Builder response;
-    response.StartDict();
+//Маршрут между остановками с учётом кеша маршрутов
+std::optional<RouteInfo> JsonReader::FindRoute(const PairStops& stop_ids) const {
+    if (route_cache_) {
+        if (auto route = route_cache_->Find(stop_ids)) {
+            return std::move(*route);
+        }
+    }
+    std::optional<RouteInfo> route = trans_router_->SearchRoute(stop_ids.first, stop_ids.second);
+    if (route_cache_) {
+        route_cache_->Insert(stop_ids, route);
+    }
+    return route;
+}
 
-    std::ostringstream output;
-    RenderMap(output);
+//Обработка запроса о отрисовки карты. Части карты отрисовываются по индексу при каждом запросе,
+//вся карта берётся из кеша
+void JsonReader::ProcessRenderMap(const json::ArenaDict& map_request, json::Writer& response) {
+    const std::optional<renderer::Rect> viewport = GetMapViewport(map_request);
+    response.StartDict();
+    if (viewport) {
+        response.Key("map").Value(map_render_->RenderMap(*viewport));
+    }
+    else {
+        response.Key("map").RawValue(GetMapText());
+    }
+    response.Key("request_id").Value(map_request.at("id").AsInt());
+    response.EndDict();
+}
 
-    response.Key("request_id").Value(json::Node{req_id});;
-    response.Key("map").Value(output.str());
+//Тайл {"z", "x", "y"}: карта делится на 2^z × 2^z частей. Рамка {"min_lat", "min_lng", "max_lat", "max_lng"}
+//задаётся географическими координатами
+std::optional<renderer::Rect> JsonReader::GetMapViewport(const json::ArenaDict& map_request) {
+    if (const json::ArenaNode* tile = map_request.Find("tile")) {
+        const json::ArenaDict tile_info = tile->AsMap();
+        const int z = tile_info.at("z").AsInt();
+        const int x = tile_info.at("x").AsInt();
+        const int y = tile_info.at("y").AsInt();
+        if (z < 0 || z > MAX_TILE_ZOOM || x < 0 || y < 0 || x >= (1 << z) || y >= (1 << z)) {
+            throw json::ParsingError("Failed to read map tile");
+        }
+        EnsureMapIndex();
+        return map_render_->GetTileViewport(z, x, y);
+    }
+    if (const json::ArenaNode* bbox = map_request.Find("bbox")) {
+        const json::ArenaDict bbox_info = bbox->AsMap();
+        const geo::Coordinates min{bbox_info.at("min_lat").AsDouble(), bbox_info.at("min_lng").AsDouble()};
+        const geo::Coordinates max{bbox_info.at("max_lat").AsDouble(), bbox_info.at("max_lng").AsDouble()};
+        if (!std::isfinite(min.lat) || !std::isfinite(min.lng) || !std::isfinite(max.lat) || !std::isfinite(max.lng)
+            || min.lat > max.lat || min.lng > max.lng) {
+            throw json::ParsingError("Failed to read map bbox");
+        }
+        EnsureMapIndex();
+        return map_render_->GetGeoViewport(min, max);
+    }
+    return std::nullopt;
+}
 
-    response.EndDict();
-    response_array_.Value(response.Build());
+//Карта в виде строки JSON, экранированная при первом запросе Map. Карта берётся из базы;
+//в базе без карты она отрисовывается здесь же
+const std::string& JsonReader::GetMapText() {
+    std::lock_guard lock(render_mutex_);
+    if (map_text_.empty()) {
+        if (map_render_->GetSvg().empty()) {
+            map_render_->SetSvg(RenderMap());
+        }
+        json::Writer(map_text_).Value(map_render_->GetSvg());
+    }
+    return map_text_;
 }
 
 //Обработка запросов
 void JsonReader::ProcessRequest() {
+    if (read_error_) {
+        std::rethrow_exception(read_error_);
+    }
+    EnsureBaseLoaded();
+    AnswerStatRequests();
+}
 
+//Загрузка базы, если она ещё не загружена из файла serialization_settings
+void JsonReader::EnsureBaseLoaded() {
+    if (!base_ || serialization_settings_.at("file").AsString() != loaded_file_) {
+        LogDuration timer("open base", GetTimingsOutput());
+        LoadBase();
+    }
+}
 
-    proto_info::ProtoInfo deserializator;
-    deserializator.Deserialization(serialization_settings_.at("file").AsString());
+//Открытие базы из файла serialization_settings: читается только оглавление, секции загружаются
+//в LoadSections под запросы очередной порции
+void JsonReader::LoadBase() {
+    route_cache_.reset();
+    trans_router_.reset();
+    map_render_.reset();
+    map_text_.clear();
+    db_ = TransportCatalogue();
+    is_catalogue_loaded_ = false;
+    is_bus_infos_loaded_ = false;
+    is_svg_loaded_ = false;
+    base_.reset();
+    loaded_file_.clear();
+
+    const std::string& file = serialization_settings_.at("file").AsString();
+    auto base = std::make_unique<proto_info::ProtoInfo>();
+    base->Deserialization(file);
+    base_ = std::move(base);
+    loaded_file_ = file;
+}
 
+//Части базы, нужные запросам: Stop — каталог, Bus — каталог и статистика маршрутов, Route — каталог
+//и маршрутизатор, Map — настройки карты и готовая карта либо каталог, если рисуется часть карты или
+//готовой карты в базе нет. Расстояния по дорогам не нужны вовсе: длины маршрутов сохранены
+//в статистике, а время поездок — в графе
+JsonReader::LoadPlan JsonReader::PlanLoad() const {
+    LoadPlan plan;
+    for (const json::ArenaNode* request : stat_requests_) {
+        const json::ArenaDict request_info = request->AsMap();
+        const json::ArenaNode* type_node = request_info.Find("type");
+        if (type_node == nullptr || !type_node->IsString()) {
+            continue;
+        }
+        const std::string_view type = type_node->AsString();
+        if (type == "Stop") {
+            plan.catalogue = true;
+        }
+        else if (type == "Bus") {
+            plan.catalogue = true;
+            plan.bus_infos = true;
+        }
+        else if (type == "Route") {
+            plan.catalogue = true;
+            plan.router = true;
+        }
+        else if (type == "Map") {
+            plan.map_settings = true;
+            if (request_info.Find("tile") != nullptr || request_info.Find("bbox") != nullptr || !base_->HasSvg()) {
+                plan.catalogue = true;
+            }
+            else {
+                plan.svg = true;
+            }
+        }
+    }
+    return plan;
+}
 
-    for (const Stop& stop : deserializator.ParseProtoStops()) {
-        db_.AddStop(stop);
+//Части базы загружаются в основном потоке до того, как запросы раздаются пулу: потоки пула
+//только читают каталог
+void JsonReader::LoadSections(const LoadPlan& plan) {
+    if (plan.catalogue) {
+        LoadCatalogue();
     }
-    db_.SetDistancesToStops(deserializator.ParseProtoDistance(db_));
+    if (plan.bus_infos) {
+        LoadBusInfos();
+    }
+    if (plan.map_settings) {
+        LoadMapSettings();
+    }
+    if (plan.svg) {
+        LoadSvg();
+    }
+    if (plan.router) {
+        LoadRouter();
+    }
+}
 
-    for (const Bus& bus : deserializator.ParseProtoBuses(db_) ) {
+void JsonReader::LoadCatalogue() {
+    if (is_catalogue_loaded_) {
+        return;
+    }
+    LogDuration timer("load catalogue", GetTimingsOutput());
+    for (const Stop& stop : base_->ParseProtoStops()) {
+        db_.AddStop(stop);
+    }
+    for (const Bus& bus : base_->ParseProtoBuses(db_) ) {
         db_.AddBus(bus);
     }
+    is_catalogue_loaded_ = true;
+}
+
+void JsonReader::LoadBusInfos() {
+    if (is_bus_infos_loaded_) {
+        return;
+    }
+    LogDuration timer("load bus stats", GetTimingsOutput());
+    db_.SetBusInfos(base_->ParseProtoBusInfos());
+    is_bus_infos_loaded_ = true;
+}
+
+void JsonReader::LoadMapSettings() {
+    if (map_render_) {
+        return;
+    }
+    LogDuration timer("load render settings", GetTimingsOutput());
+    auto map_render = std::make_unique<renderer::MapRenderer>();
+    base_->ParseProtoMap(*map_render);
+    map_render_ = std::move(map_render);
+}
 
-    map_render_ = std::make_unique<renderer::MapRenderer>();
-    deserializator.ParseProtoMap(*map_render_.get());
+void JsonReader::LoadSvg() {
+    if (is_svg_loaded_) {
+        return;
+    }
+    LogDuration timer("load svg", GetTimingsOutput());
+    map_render_->SetSvg(base_->ParseProtoSvg());
+    is_svg_loaded_ = true;
+}
 
-    trans_router_ = std::make_unique<TransportRouter>(db_);
-    deserializator.ParseProtoTransportRouter(*trans_router_, db_);
+void JsonReader::LoadRouter() {
+    if (trans_router_) {
+        return;
+    }
+    LogDuration timer("load router", GetTimingsOutput());
+    auto trans_router = std::make_unique<TransportRouter>(db_);
+    base_->ParseProtoTransportRouter(*trans_router);
+    if (trans_router->GetRouteCacheSize() > 0) {
+        route_cache_ = std::make_unique<LruCache<PairStops, std::optional<RouteInfo>, PairStopsHasher>>(
+            trans_router->GetRouteCacheSize());
+    }
+    trans_router_ = std::move(trans_router);
+}
 
+//Ответ на один запрос из stat_requests
+void JsonReader::AnswerRequest(const json::ArenaDict& request, json::Writer& response) {
+    const std::string_view type = request.at("type").AsString();
+    if (type == "Stop") {
+        ProcessStopRequest(request, response);
+    }
+    else if (type == "Bus") {
+        ProcessBusRequest(request, response);
+    }
+    else if (type == "Map") {
+        ProcessRenderMap(request, response);
+    }
+    else if (type == "Route") {
+        ProcessRoute(request, response);
+    }
+    else {
+        throw std::runtime_error("Processing requests error");
+    }
+}
 
-    response_array_.StartArray();
-    for (const auto& request : stat_requests_) {
-        if (request.AsMap().at("type").AsString() == "Stop") {
-            ProcessStopRequest(request.AsMap());
+//Ответы на stat_requests_ по уже загруженной базе дописываются к массиву ответов, выполненные
+//запросы удаляются. Запросы только читают каталог и маршрутизатор, поэтому раздаются пулу
+//потоков порциями; каждая порция пишет ответы в свой буфер, и буферы выводятся в порядке
+//запросов
+void JsonReader::AnswerStatRequests() {
+    std::ostream* timings_output = GetTimingsOutput();
+    LoadPlan plan;
+    {
+        LogDuration timer("plan", timings_output);
+        plan = PlanLoad();
+    }
+    LoadSections(plan);
+
+    {
+        LogDuration timer("answer "s + std::to_string(stat_requests_.size()) + " requests"s, timings_output);
+        const size_t chunk_count = (stat_requests_.size() + REQUESTS_CHUNK_SIZE - 1) / REQUESTS_CHUNK_SIZE;
+        std::vector<std::string> chunk_texts(chunk_count);
+        auto answer_chunk = [this, &chunk_texts](size_t chunk) {
+            json::Writer response(chunk_texts[chunk]);
+            const size_t begin = chunk * REQUESTS_CHUNK_SIZE;
+            const size_t end = std::min(stat_requests_.size(), begin + REQUESTS_CHUNK_SIZE);
+            for (size_t i = begin; i < end; ++i) {
+                if (i != begin) {
+                    chunk_texts[chunk] += ", ";
+                }
+                AnswerRequest(stat_requests_[i]->AsMap(), response);
+            }
+        };
+        ThreadPool* thread_pool = GetThreadPool();
+        if (thread_pool != nullptr && chunk_count > 1) {
+            thread_pool->ParallelFor(chunk_count, answer_chunk);
         }
-        else if (request.AsMap().at("type").AsString() == "Bus") {
-            ProcessBusRequest(request.AsMap());
+        else {
+            for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+                answer_chunk(chunk);
+            }
         }
-        else if (request.AsMap().at("type").AsString() == "Map") {
-            ProcessRenderMap(request.AsMap().at("id").AsInt());
+
+        for (const std::string& text : chunk_texts) {
+            AppendResponses(text);
         }
-        else if (request.AsMap().at("type").AsString() == "Route") {
-            ProcessRoute(request.AsMap());
+        stat_requests_.clear();
+        requests_document_.Clear();
+    }
+
+    if (timings_output != nullptr && route_cache_) {
+        *timings_output << "route cache: "sv << route_cache_->GetHitCount() << " hits, "sv
+                        << route_cache_->GetMissCount() << " misses\n"sv;
+    }
+}
+
+//Дописывает ответы к массиву ответов; накопленный текст выводится, когда превышает OUTPUT_BUFFER_SIZE
+void JsonReader::AppendResponses(const std::string& text) {
+    if (text.empty()) {
+        return;
+    }
+    if (has_responses_) {
+        response_text_ += ", ";
+    }
+    response_text_ += text;
+    has_responses_ = true;
+    if (response_text_.size() >= OUTPUT_BUFFER_SIZE) {
+        FlushResponses();
+    }
+}
+
+void JsonReader::FlushResponses() {
+    output_->write(response_text_.data(), response_text_.size());
+    response_text_.clear();
+    is_output_flushed_ = true;
+}
+
+//Пул потоков под число потоков из execution_settings; при одном потоке пул не нужен
+ThreadPool* JsonReader::GetThreadPool() {
+    size_t thread_count = GetThreadCount();
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (thread_count == 1) {
+        thread_pool_.reset();
+        return nullptr;
+    }
+    if (!thread_pool_ || thread_pool_->GetThreadCount() != thread_count) {
+        thread_pool_ = std::make_unique<ThreadPool>(thread_count);
+    }
+    return thread_pool_.get();
+}
+
+//Серверный режим: база загружается по первому пакету и переиспользуется следующими.
+//Пакет — JSON-документ вида входа process_requests; документы идут подряд
+//(например, по одному в строке). На каждый пакет выводится массив ответов и перевод строки
+void JsonReader::Serve(std::istream& input, std::ostream& output) {
+    SetOutput(output);
+    //Блок, прочитанный из потока, может содержать начало следующего пакета, поэтому Reader общий
+    json::Reader reader(input);
+    while (reader.SkipWhitespace()) {
+        //Ошибка в пакете не останавливает сервер: вместо массива ответов выводится её описание.
+        //Если часть большого массива уже выведена, описание ошибки завершает массив
+        bool is_read = false;
+        try {
+            ReadJson(reader, "process_requests"sv);
+            is_read = true;
+            ProcessRequest();
+            PrintResponseArray();
         }
-        else {
-            throw std::runtime_error("Processing requests error");
+        catch (const std::exception& e) {
+            //Пакет, прочитанный не до конца, пропускается до конца строки: следующий пакет
+            //читается с новой строки
+            if (!is_read) {
+                reader.SkipLine();
+            }
+            if (!is_output_flushed_) {
+                response_text_.clear();
+            }
+            else if (has_responses_) {
+                response_text_ += ", ";
+            }
+            json::Writer(response_text_).StartDict().Key("error_message").Value(e.what()).EndDict();
+            if (is_output_flushed_) {
+                response_text_ += ']';
+            }
+            FlushResponses();
         }
+        output << '\n';
+        output.flush();
     }
-
-    response_array_.EndArray();
 }
 
-//Отрисовка карты
-void JsonReader::RenderMap(std::ostream& output) {
+//Отрисовка карты в формате SVG
+std::string JsonReader::RenderMap() {
 //    map_renderer_ = std::make_unique<renderer::MapRenderer>(GetRenderSettings());
     RequestHandler req_handler(db_, *map_render_);
-    req_handler.RenderMap().Render(output);
+    return req_handler.RenderMap();
+}
+
+//Индекс строится под блокировкой один раз на базу; после этого части карты отрисовываются без неё
+void JsonReader::EnsureMapIndex() {
+    std::lock_guard lock(render_mutex_);
+    if (!map_render_->HasIndex()) {
+        RequestHandler req_handler(db_, *map_render_);
+        req_handler.BuildMapIndex();
+    }
+}
+
+//Поток для ответов на stat_requests
+void JsonReader::SetOutput(std::ostream& output) {
+    output_ = &output;
 }
 
-//Вывод JSON-массива ответов
-void JsonReader::PrintResponseArray(std::ostream& output) {
-    json::Print(response_array_.Build(), output);
+//Завершение и вывод JSON-массива ответов
+void JsonReader::PrintResponseArray() {
+    response_text_ += ']';
+    FlushResponses();
 
 }
@@ -5,18 +5,30 @@
 #include "map_renderer.h"
 #include "svg.h"
 #include "json_builder.h"
+#include "json_writer.h"
 #include "transport_router.h"
 #include "map_renderer.h"
+#include "lru_cache.h"
+#include "thread_pool.h"
+#include "serialization.h"
+#include "log_duration.h"
 
+#include <exception>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
 
 class JsonReader {
 public:
     JsonReader(TransportCatalogue db);
 
-    //Чтение Json и определение base_requests_ и stat_requests_
+    //Потоковое чтение Json: в режиме make_base остановки сразу добавляются в каталог,
+    //в режиме process_requests запросы stat_requests выполняются порциями по ходу чтения
     void ReadJson(std::istream& input, std::string_view mode);
+    void ReadJson(json::Reader& input, std::string_view mode);
 
     //Загрузка данных в транспортный каталог
     void LoadData();
@@ -24,48 +36,178 @@ public:
     //Обработка запросов
     void ProcessRequest();
 
-    //Вывод JSON-массива ответов
-    void PrintResponseArray(std::ostream& output);
+    //Серверный режим: база загружается один раз, пакеты запросов читаются из input до конца потока
+    void Serve(std::istream& input, std::ostream& output);
+
+    //Поток для ответов на stat_requests: ответы выводятся по мере выполнения запросов
+    void SetOutput(std::ostream& output);
+
+    //Завершение и вывод JSON-массива ответов
+    void PrintResponseArray();
 
 private:
+    class InputHandler;
+
     TransportCatalogue db_;
     std::unique_ptr<TransportRouter> trans_router_;
     std::unique_ptr<renderer::MapRenderer> map_render_;
-    json::Array base_requests_;
-    json::Array stat_requests_;
+    std::string mode_;
+    //Элементы base_requests и stat_requests, разобранные в одну арену. В режиме make_base освобождаются
+    //после загрузки данных, в режиме process_requests — после ответа на очередную порцию запросов
+    json::ArenaDocument requests_document_;
+    //Запросы Bus из base_requests, отложенные до конца чтения: остановки маршрута могут быть описаны позже
+    std::vector<const json::ArenaNode*> base_requests_;
+    //Прочитанные, но ещё не выполненные запросы stat_requests
+    std::vector<const json::ArenaNode*> stat_requests_;
     json::Dict render_settings_;
     json::Dict routing_settings_;
-    json::Builder response_array_;
+    std::ostream* output_ = &std::cout;
+    //Ещё не выведенный текст массива ответов
+    std::string response_text_;
+    //В массив ответов записан хотя бы один ответ
+    bool has_responses_ = false;
+    //Часть массива ответов уже выведена в output_
+    bool is_output_flushed_ = false;
+    //Карта в виде строки JSON, общая для всех запросов Map; пустая, пока не запрошена
+    std::string map_text_;
+    //Карта отрисовывается и экранируется, а индекс карты строится один раз; запросы Map ждут,
+    //пока это не будет сделано
+    std::mutex render_mutex_;
     json::Dict serialization_settings_;
+    json::Dict execution_settings_;
+    //Файл базы, загруженной в db_
+    std::string loaded_file_;
+    //Открытый файл базы: его секции загружаются, когда понадобятся очередным запросам
+    std::unique_ptr<proto_info::ProtoInfo> base_;
+    //Загруженные части базы; настройки карты и маршрутизатор загружены, если map_render_
+    //и trans_router_ не пусты
+    bool is_catalogue_loaded_ = false;
+    bool is_bus_infos_loaded_ = false;
+    bool is_svg_loaded_ = false;
+    //serialization_settings текущего документа прочитаны, и запросы можно выполнять по ходу чтения
+    bool is_base_ready_ = false;
+    //Ошибка обработки, случившаяся во время чтения; пробрасывается из LoadData и ProcessRequest
+    std::exception_ptr read_error_;
+    //Найденные маршруты по паре номеров остановок
+    std::unique_ptr<LruCache<PairStops, std::optional<RouteInfo>, PairStopsHasher>> route_cache_;
+    std::unique_ptr<ThreadPool> thread_pool_;
+
+    //Наибольший масштаб тайла карты: номера тайлов x и y меньше 2^z
+    static constexpr int MAX_TILE_ZOOM = 30;
+    //Число запросов, которое поток пула обрабатывает за одну задачу
+    static constexpr size_t REQUESTS_CHUNK_SIZE = 256;
+    //Число маршрутов, статистику которых поток пула считает за одну задачу
+    static constexpr size_t BUSES_CHUNK_SIZE = 256;
+    //Число прочитанных запросов stat_requests, после которого они выполняются, не дожидаясь конца чтения
+    static constexpr size_t STAT_REQUESTS_BATCH_SIZE = 16 * REQUESTS_CHUNK_SIZE;
+    //Размер накопленного текста ответов, после которого он выводится в output_
+    static constexpr size_t OUTPUT_BUFFER_SIZE = 1 << 20;
+
+    //Открытие базы из файла serialization_settings
+    void LoadBase();
+
+    //Части базы, которые нужны порции запросов
+    struct LoadPlan {
+        bool catalogue = false;
+        bool bus_infos = false;
+        bool map_settings = false;
+        bool svg = false;
+        bool router = false;
+    };
+
+    //Планирование: какие части базы нужны запросам stat_requests_
+    LoadPlan PlanLoad() const;
+    //Загрузка ещё не загруженных частей базы по плану
+    void LoadSections(const LoadPlan& plan);
+    //Остановки и маршруты
+    void LoadCatalogue();
+    //Статистика маршрутов
+    void LoadBusInfos();
+    //Настройки отрисовки карты
+    void LoadMapSettings();
+    //Готовая карта
+    void LoadSvg();
+    //Маршрутизатор и кеш маршрутов
+    void LoadRouter();
+
+    //Загрузка базы, если она ещё не загружена из файла serialization_settings
+    void EnsureBaseLoaded();
+
+    //Ключ верхнего уровня входного документа, кроме base_requests и stat_requests
+    void ReadSetting(const std::string& key, json::Node value);
+
+    //Очередной элемент массива base_requests или stat_requests
+    void ReadRequest(const std::string& key, const json::ArenaNode& request);
+
+    //Ответы на stat_requests_ по загруженной базе
+    void AnswerStatRequests();
+
+    //Ответ на один запрос из stat_requests
+    void AnswerRequest(const json::ArenaDict& request, json::Writer& response);
+
+    //Дописывает ответы к массиву ответов
+    void AppendResponses(const std::string& text);
+    //Вывод накопленного текста ответов
+    void FlushResponses();
+
+    //Пул потоков для ответов на запросы или nullptr, если запросы выполняются в одном потоке
+    ThreadPool* GetThreadPool();
+
+    //Расчёт статистики всех маршрутов каталога в пуле потоков
+    void ComputeBusInfos();
+
 
     //Обработка запроса на добавления остановки
-    void ParsingStop(const json::Dict& stop_info);
+    void ParsingStop(const json::ArenaDict& stop_info);
 
     //Обработка запроса на добавления остановки
-    void ParsingBus(const json::Dict& bus_info);
+    void ParsingBus(const json::ArenaDict& bus_info);
 
-    const DistancesToStops DictStrNodeToStrInt(const json::Dict& distances_node);
+    const DistancesToStops DictStrNodeToStrInt(const json::ArenaDict& distances_node);
 
     //Обработка запроса об остановке
-    void ProcessStopRequest(const json::Dict& stop_request);
+    void ProcessStopRequest(const json::ArenaDict& stop_request, json::Writer& response) const;
 
     //Обработка запроса о маршруте
-    void ProcessBusRequest(const json::Dict& bus_request);
+    void ProcessBusRequest(const json::ArenaDict& bus_request, json::Writer& response) const;
 
     //Обработка запроса о построении маршрута
-    void ProcessRoute(const json::Dict& route_request);
+    void ProcessRoute(const json::ArenaDict& route_request, json::Writer& response) const;
 
-    json::Node RouteInfoToJson(const std::vector<EdgeInfo>& edge_info) const;
+    //Маршрут между остановками с учётом кеша маршрутов
+    std::optional<RouteInfo> FindRoute(const PairStops& stop_ids) const;
 
-    //Обработка запроса о отрисовки карты
-    void ProcessRenderMap(int req_id);
+    void WriteRouteItems(const std::vector<EdgeInfo>& edge_info, json::Writer& response) const;
 
-    //Отрисовка карты
-    void RenderMap(std::ostream& output);
+    //Обработка запроса о отрисовки карты: вся карта либо её часть по ключу tile или bbox
+    void ProcessRenderMap(const json::ArenaDict& map_request, json::Writer& response);
+
+    //Область карты из ключа tile или bbox запроса Map
+    std::optional<renderer::Rect> GetMapViewport(const json::ArenaDict& map_request);
+
+    //Карта в виде строки JSON
+    const std::string& GetMapText();
+
+    //Отрисовка карты в формате SVG
+    std::string RenderMap();
+
+    //Индекс карты строится по первому запросу части карты
+    void EnsureMapIndex();
 
     //Получение данных для вывод карты
     renderer::RenderSettings GetRenderSettings();
 
+    //Получение типа маршрутизатора из routing_settings
+    RouterType GetRouterType() const;
+    //Получение модели графа маршрутов из routing_settings
+    GraphModel GetGraphModel() const;
+    //Получение размера кеша маршрутов из routing_settings
+    size_t GetRouteCacheSize() const;
+    //Получение числа потоков из execution_settings
+    size_t GetThreadCount() const;
+    //Поток для времени этапов обработки или nullptr, если в execution_settings оно не запрошено
+    std::ostream* GetTimingsOutput() const;
+
     //Отрисовка карты
     void BuildRoute(std::ostream& output);
 
@@ -0,0 +1,173 @@
+#include "json_writer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <type_traits>
+#include <variant>
+
+namespace json
+{
+    namespace
+    {
+        bool IsEscaped(char c) {
+            return c == '\n' || c == '\r' || c == '"' || c == '\\';
+        }
+    }
+
+    Writer::Writer(std::string& output)
+        : output_(output) {
+    }
+
+    void Writer::StartValue() {
+        if (is_after_key_) {
+            is_after_key_ = false;
+            return;
+        }
+        if (!has_items_.empty()) {
+            if (has_items_.back()) {
+                output_ += ", ";
+            }
+            has_items_.back() = true;
+        }
+    }
+
+    Writer& Writer::StartDict() {
+        StartValue();
+        output_ += "{\n";
+        has_items_.push_back(false);
+        return *this;
+    }
+
+    Writer& Writer::EndDict() {
+        output_ += "}\n";
+        has_items_.pop_back();
+        return *this;
+    }
+
+    Writer& Writer::StartArray() {
+        StartValue();
+        output_ += '[';
+        has_items_.push_back(false);
+        return *this;
+    }
+
+    Writer& Writer::EndArray() {
+        output_ += ']';
+        has_items_.pop_back();
+        return *this;
+    }
+
+    // Ключ выводится без экранирования, как в json::Print
+    Writer& Writer::Key(std::string_view key) {
+        if (has_items_.back()) {
+            output_ += "\n, ";
+        }
+        has_items_.back() = true;
+        output_ += '"';
+        output_ += key;
+        output_ += "\": ";
+        is_after_key_ = true;
+        return *this;
+    }
+
+    Writer& Writer::Value(std::nullptr_t) {
+        StartValue();
+        output_ += "null";
+        return *this;
+    }
+
+    Writer& Writer::Value(bool value) {
+        StartValue();
+        output_ += value ? "true" : "false";
+        return *this;
+    }
+
+    Writer& Writer::Value(int value) {
+        StartValue();
+        char buffer[16];
+        const auto result = std::to_chars(std::begin(buffer), std::end(buffer), value);
+        output_.append(buffer, result.ptr);
+        return *this;
+    }
+
+    // Шесть значащих цифр в общем формате — так double выводит std::ostream по умолчанию
+    Writer& Writer::Value(double value) {
+        StartValue();
+        char buffer[32];
+        const auto result = std::to_chars(std::begin(buffer), std::end(buffer), value, std::chars_format::general, 6);
+        output_.append(buffer, result.ptr);
+        return *this;
+    }
+
+    // Строка экранируется так же, как в json::Print; участки без спецсимволов копируются целиком
+    Writer& Writer::Value(std::string_view value) {
+        StartValue();
+        output_ += '"';
+        auto begin = value.begin();
+        while (begin != value.end()) {
+            const auto special = std::find_if(begin, value.end(), IsEscaped);
+            output_.append(begin, special);
+            if (special == value.end()) {
+                break;
+            }
+            switch (*special) {
+            case '\n':
+                output_ += "\\n";
+                break;
+            case '\r':
+                output_ += "\\r";
+                break;
+            case '"':
+                output_ += "\\\"";
+                break;
+            default:
+                output_ += "\\\\";
+                break;
+            }
+            begin = special + 1;
+        }
+        output_ += '"';
+        return *this;
+    }
+
+    Writer& Writer::Value(const char* value) {
+        return Value(std::string_view(value));
+    }
+
+    Writer& Writer::Value(const std::string& value) {
+        return Value(std::string_view(value));
+    }
+
+    Writer& Writer::RawValue(std::string_view json_text) {
+        StartValue();
+        output_ += json_text;
+        return *this;
+    }
+
+    Writer& Writer::Value(const Node& node) {
+        if (node.IsArray()) {
+            StartArray();
+            for (const Node& item : node.AsArray()) {
+                Value(item);
+            }
+            return EndArray();
+        }
+        if (node.IsMap()) {
+            StartDict();
+            for (const auto& [key, item] : node.AsMap()) {
+                Key(key);
+                Value(item);
+            }
+            return EndDict();
+        }
+        std::visit([this](const auto& value) {
+            using T = std::decay_t<decltype(value)>;
+            if constexpr (!std::is_same_v<T, Array> && !std::is_same_v<T, Dict>) {
+                Value(value);
+            }
+        }, node.GetValue());
+        return *this;
+    }
+
+}
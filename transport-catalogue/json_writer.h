@@ -0,0 +1,54 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace json
+{
+
+    // Запись JSON-текста прямо в строку без построения дерева Node.
+    // Текст совпадает с выводом json::Print, если ключи словарей передаются
+    // в алфавитном порядке: Print выводит словарь в порядке std::map
+    class Writer
+    {
+    public:
+
+        explicit Writer(std::string& output);
+
+        Writer& StartDict();
+        Writer& EndDict();
+
+        Writer& StartArray();
+        Writer& EndArray();
+
+        Writer& Key(std::string_view key);
+
+        Writer& Value(std::nullptr_t);
+        Writer& Value(bool value);
+        Writer& Value(int value);
+        Writer& Value(double value);
+        Writer& Value(std::string_view value);
+        Writer& Value(const char* value);
+        Writer& Value(const std::string& value);
+        Writer& Value(const Node& node);
+
+        // Значение, уже записанное JSON-текстом
+        Writer& RawValue(std::string_view json_text);
+
+    private:
+
+        std::string& output_;
+        // Для каждого открытого словаря или массива: записан ли в него хотя бы один элемент
+        std::vector<bool> has_items_;
+        // Ключ записан, ожидается его значение
+        bool is_after_key_ = false;
+
+        // Разделитель перед очередным значением массива
+        void StartValue();
+    };
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+//Замер времени этапа: при выходе из области видимости в output выводится строка
+//"<название>: <время> ms". Если output пуст, время не выводится
+class LogDuration {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    LogDuration(std::string_view id, std::ostream* output)
+        : id_(id)
+        , output_(output) {
+    }
+
+    LogDuration(const LogDuration&) = delete;
+    LogDuration& operator=(const LogDuration&) = delete;
+
+    ~LogDuration() {
+        if (output_ == nullptr) {
+            return;
+        }
+        const std::chrono::duration<double, std::milli> duration = Clock::now() - start_time_;
+        //Строка выводится одной записью под общей блокировкой: этапы из разных потоков пишут
+        //в один поток вывода, а без синхронизации со stdio его буфер не защищён
+        std::ostringstream line;
+        line << id_ << ": " << duration.count() << " ms\n";
+        static std::mutex output_mutex;
+        std::lock_guard lock(output_mutex);
+        *output_ << line.str();
+    }
+
+private:
+    const std::string id_;
+    std::ostream* const output_;
+    const Clock::time_point start_time_ = Clock::now();
+};
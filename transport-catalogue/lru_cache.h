@@ -0,0 +1,99 @@
+#pragma once
+
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+// Потокобезопасный кеш ограниченного размера: при переполнении вытесняется
+// запись, к которой дольше всего не обращались. Ведёт счётчики попаданий и промахов
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache {
+public:
+    explicit LruCache(size_t capacity);
+
+    // Копия значения по ключу; найденная запись становится самой свежей
+    std::optional<Value> Find(const Key& key);
+
+    // Добавляет или заменяет значение по ключу
+    void Insert(const Key& key, Value value);
+
+    size_t GetCapacity() const;
+    size_t GetSize() const;
+    size_t GetHitCount() const;
+    size_t GetMissCount() const;
+
+private:
+    using Entry = std::pair<Key, Value>;
+
+    size_t capacity_;
+    // Записи от самой свежей к самой старой
+    std::list<Entry> entries_;
+    std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> positions_;
+    size_t hit_count_ = 0;
+    size_t miss_count_ = 0;
+    mutable std::mutex mutex_;
+};
+
+template <typename Key, typename Value, typename Hash>
+LruCache<Key, Value, Hash>::LruCache(size_t capacity)
+    : capacity_(capacity) {
+}
+
+template <typename Key, typename Value, typename Hash>
+std::optional<Value> LruCache<Key, Value, Hash>::Find(const Key& key) {
+    std::lock_guard lock(mutex_);
+    const auto position = positions_.find(key);
+    if (position == positions_.end()) {
+        ++miss_count_;
+        return std::nullopt;
+    }
+    ++hit_count_;
+    entries_.splice(entries_.begin(), entries_, position->second);
+    return position->second->second;
+}
+
+template <typename Key, typename Value, typename Hash>
+void LruCache<Key, Value, Hash>::Insert(const Key& key, Value value) {
+    if (capacity_ == 0) {
+        return;
+    }
+    std::lock_guard lock(mutex_);
+    const auto position = positions_.find(key);
+    if (position != positions_.end()) {
+        position->second->second = std::move(value);
+        entries_.splice(entries_.begin(), entries_, position->second);
+        return;
+    }
+    if (entries_.size() == capacity_) {
+        positions_.erase(entries_.back().first);
+        entries_.pop_back();
+    }
+    entries_.emplace_front(key, std::move(value));
+    positions_.emplace(key, entries_.begin());
+}
+
+template <typename Key, typename Value, typename Hash>
+size_t LruCache<Key, Value, Hash>::GetCapacity() const {
+    return capacity_;
+}
+
+template <typename Key, typename Value, typename Hash>
+size_t LruCache<Key, Value, Hash>::GetSize() const {
+    std::lock_guard lock(mutex_);
+    return entries_.size();
+}
+
+template <typename Key, typename Value, typename Hash>
+size_t LruCache<Key, Value, Hash>::GetHitCount() const {
+    std::lock_guard lock(mutex_);
+    return hit_count_;
+}
+
+template <typename Key, typename Value, typename Hash>
+size_t LruCache<Key, Value, Hash>::GetMissCount() const {
+    std::lock_guard lock(mutex_);
+    return miss_count_;
+}
@@ -8,7 +8,7 @@
 using namespace std;
 
 void PrintUsage(std::ostream& stream = std::cerr) {
-    stream << "Usage: transport_catalogue [make_base|process_requests]\n"sv;
+    stream << "Usage: transport_catalogue [make_base|process_requests|serve]\n"sv;
 }
 
 int main(int argc, char* argv[]) {
@@ -18,31 +18,50 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    //Вход читается блоками через буфер cin, без синхронизации с stdio
+    std::ios::sync_with_stdio(false);
+
     const std::string_view mode(argv[1]);
     TransportCatalogue db;
     JsonReader process_json(db);
 
-    if (mode == "make_base"sv) {
-        //Чтение Json
-        process_json.ReadJson(std::cin, mode);
+    //Ошибка обработки выводится в stderr; при выходе по исключению стек раскручивается,
+    //и недописанный файл базы удаляется
+    try {
+        if (mode == "make_base"sv) {
+            //Чтение Json
+            process_json.ReadJson(std::cin, mode);
 
-        //Загрузка данных в транспортный каталог
-        process_json.LoadData();
+            //Загрузка данных в транспортный каталог
+            process_json.LoadData();
 
-    }
-    else if (mode == "process_requests"sv) {
-        //Чтение Json
-        process_json.ReadJson(std::cin, mode);
+        }
+        else if (mode == "process_requests"sv) {
+            //Ответы выводятся по мере выполнения запросов
+            process_json.SetOutput(std::cout);
+
+            //Чтение Json
+            process_json.ReadJson(std::cin, mode);
 
-        //Обработка запросов
-        process_json.ProcessRequest();
+            //Обработка запросов
+            process_json.ProcessRequest();
 
-        //Вывод JSON-массива ответов
-        process_json.PrintResponseArray(std::cout);
+            //Вывод JSON-массива ответов
+            process_json.PrintResponseArray();
 
+        }
+        else if (mode == "serve"sv) {
+            //Ответы на пакеты запросов по однажды загруженной базе
+            process_json.Serve(std::cin, std::cout);
+
+        }
+        else {
+            PrintUsage();
+            return 1;
+        }
     }
-    else {
-        PrintUsage();
+    catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
         return 1;
     }
 }
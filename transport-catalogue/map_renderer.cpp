@@ -1,5 +1,8 @@
 #include "map_renderer.h"
 
+#include <cmath>
+#include <stdexcept>
+
 
 namespace renderer {
 
@@ -27,137 +30,258 @@ void MapRenderer::SetCoordinates(std::vector<geo::Coordinates> coordinates) {
     coordinates_ = coordinates;
 }
 
-void MapRenderer::RenderRoute() {
+void MapRenderer::SetSvg(std::string svg) {
+    svg_ = std::move(svg);
+}
+
+const std::string& MapRenderer::GetSvg() const {
+    return svg_;
+}
+
+namespace {
+
+//Номера 0..count-1 — все элементы раскладки
+std::vector<uint32_t> AllNumbers(size_t count) {
+    std::vector<uint32_t> numbers(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        numbers[i] = i;
+    }
+    return numbers;
+}
+
+//Число символов UTF-8 строки
+size_t CountChars(std::string_view text) {
+    return std::count_if(text.begin(), text.end(), [](char c) {
+        return (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+    });
+}
+
+}
 
+MapRenderer::Layout MapRenderer::MakeLayout() const {
     // Создаём проектор сферических координат на карту
-   const SphereProjector proj{
-        coordinates_.begin(), coordinates_.end()
+    Layout layout{
+        SphereProjector{coordinates_.begin(), coordinates_.end()
                 , render_settings_.width
                 , render_settings_.height
-                , render_settings_.padding
+                , render_settings_.padding},
+        buses_, stops_, {}
     };
 
-    size_t colar_num = 0;
-    // Отрисовка маршрутов
-    for (const auto bus : buses_) {
-        std::vector<svg::Point> result_coords;
-        for (auto stop : bus->stops) {
-            result_coords.emplace_back(proj(stop->coordinates));
-        }
-        map_.emplace_back(std::make_unique<Route>(result_coords, render_settings_, colar_num++));
-    }
-
-    colar_num = 0;
-    // Отрисовка названий маршрутов
-    for (const auto bus : buses_) {
-        map_.emplace_back(std::make_unique<RouteName>(bus, proj(bus->stops.back()->coordinates), render_settings_, colar_num++));
+    // Надписи маршрутов: у конечной остановки и у второй конечной некольцевого маршрута
+    for (size_t bus_num = 0; bus_num < buses_.size(); ++bus_num) {
+        const Bus* bus = buses_[bus_num];
+        layout.route_labels.push_back({bus_num, bus->stops.back()});
         if (!bus->is_roundtrip) {
             auto stop = bus->stops.at(bus->stops.size() / 2);
             if (stop->stopname != bus->stops.back()->stopname) {
-            map_.emplace_back(std::make_unique<RouteName>(bus, proj(stop->coordinates), render_settings_, colar_num - 1));
+                layout.route_labels.push_back({bus_num, stop});
             }
         }
     }
+    return layout;
+}
 
-    // Отрисовка сиволов остановок
-    for (const auto stop : stops_) {
-        map_.emplace_back(std::make_unique<StopSymbol>(proj(stop->coordinates), render_settings_));
-    }
+std::string MapRenderer::RenderMap() const {
+    const Layout layout = MakeLayout();
+
+    std::string output;
+    svg::Writer writer(output);
+    writer.StartDocument();
+    RenderParts(layout, AllNumbers(layout.buses.size()), AllNumbers(layout.route_labels.size()),
+                AllNumbers(layout.stops.size()), writer);
+    writer.EndDocument();
+    return output;
+}
 
-    // Отрисовка названия остановок
-    for (const auto stop : stops_) {
-        map_.emplace_back(std::make_unique<StopName>(stop->stopname, proj(stop->coordinates), render_settings_));
+std::string MapRenderer::RenderMap(const Rect& viewport) const {
+    if (!index_) {
+        throw std::logic_error("Map index is not built");
     }
+    std::string output;
+    svg::Writer writer(output);
+    writer.StartDocument(viewport.min, {viewport.max.x - viewport.min.x, viewport.max.y - viewport.min.y});
+    RenderParts(index_->layout, index_->routes.Find(viewport), index_->route_labels.Find(viewport),
+                index_->stops.Find(viewport), writer);
+    writer.EndDocument();
+    return output;
+}
+
+Rect MapRenderer::GetLabelRect(svg::Point position, std::pair<double, double> offset, size_t font_size,
+                               std::string_view text) const {
+    const double x = position.x + offset.first;
+    const double y = position.y + offset.second;
+    const double size = static_cast<double>(font_size);
+    const Rect label{{x, y - size}, {x + size * CountChars(text), y + size}};
+    return label.Expanded(render_settings_.underlayer_width / 2);
 }
 
-svg::Document MapRenderer::RenderMap() {
+//Маршрут индексируется по отрезкам ломаной: рамка всего маршрута через город задела бы почти
+//все ячейки. Надписи и остановки — по рамкам текста и круга
+void MapRenderer::BuildIndex() {
+    Layout layout = MakeLayout();
+    const SphereProjector& proj = layout.projector;
+
+    std::vector<GridIndex::Item> route_items;
+    for (uint32_t bus_num = 0; bus_num < layout.buses.size(); ++bus_num) {
+        const std::vector<const Stop*>& stops = layout.buses[bus_num]->stops;
+        svg::Point from = proj(stops.front()->coordinates);
+        for (size_t i = (stops.size() > 1 ? 1 : 0); i < stops.size(); ++i) {
+            const svg::Point to = proj(stops[i]->coordinates);
+            route_items.push_back({Rect{from, from}.Union({to, to}).Expanded(render_settings_.line_width / 2), bus_num});
+            from = to;
+        }
+    }
 
-    svg::Document doc;
-    DrawPicture(map_, doc);
+    std::vector<GridIndex::Item> label_items;
+    label_items.reserve(layout.route_labels.size());
+    for (uint32_t label_num = 0; label_num < layout.route_labels.size(); ++label_num) {
+        const RouteLabel& label = layout.route_labels[label_num];
+        label_items.push_back({GetLabelRect(proj(label.stop->coordinates), render_settings_.bus_label_offset,
+                                            render_settings_.bus_label_font_size, layout.buses[label.bus_num]->busname),
+                               label_num});
+    }
 
-    return doc;
+    std::vector<GridIndex::Item> stop_items;
+    stop_items.reserve(layout.stops.size());
+    for (uint32_t stop_num = 0; stop_num < layout.stops.size(); ++stop_num) {
+        const Stop* stop = layout.stops[stop_num];
+        const svg::Point point = proj(stop->coordinates);
+        const Rect symbol = Rect{point, point}.Expanded(render_settings_.stop_radius);
+        stop_items.push_back({symbol.Union(GetLabelRect(point, render_settings_.stop_label_offset,
+                                                        render_settings_.stop_label_font_size, stop->stopname)),
+                              stop_num});
+    }
+
+    // В ячейке в среднем около одной остановки
+    const Rect bounds{{0.0, 0.0}, {render_settings_.width, render_settings_.height}};
+    const size_t cells_per_side = std::clamp<size_t>(static_cast<size_t>(std::sqrt(layout.stops.size())), 1, MAX_CELLS_PER_SIDE);
+    index_ = std::make_unique<const MapIndex>(MapIndex{
+        std::move(layout),
+        GridIndex(bounds, cells_per_side, std::move(route_items)),
+        GridIndex(bounds, cells_per_side, std::move(label_items)),
+        GridIndex(bounds, cells_per_side, std::move(stop_items))
+    });
+}
+
+bool MapRenderer::HasIndex() const {
+    return index_ != nullptr;
 }
 
-void Route::Draw(svg::ObjectContainer& container) const {
-    svg::Polyline route;
-    route.SetFillColor(svg::NoneColor);
-    route.SetStrokeColor(render_settings_.color_palette.at(colar_num % render_settings_.color_palette.size()));
-    route.SetStrokeWidth(render_settings_.line_width);
-    route.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
-    route.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+Rect MapRenderer::GetTileViewport(uint32_t z, uint32_t x, uint32_t y) const {
+    const double tile_count = static_cast<double>(uint64_t{1} << z);
+    const double width = render_settings_.width / tile_count;
+    const double height = render_settings_.height / tile_count;
+    return {{x * width, y * height}, {(x + 1) * width, (y + 1) * height}};
+}
 
-    for (const auto& stop : stops_) {
-        route.AddPoint(stop);
+//Широта растёт вверх, а координата y на карте — вниз
+Rect MapRenderer::GetGeoViewport(geo::Coordinates min, geo::Coordinates max) const {
+    if (!index_) {
+        throw std::logic_error("Map index is not built");
     }
-    container.Add(route);
+    const SphereProjector& proj = index_->layout.projector;
+    return {proj({max.lat, min.lng}), proj({min.lat, max.lng})};
+}
+
+void MapRenderer::RenderParts(const Layout& layout, const std::vector<uint32_t>& bus_nums,
+                              const std::vector<uint32_t>& label_nums, const std::vector<uint32_t>& stop_nums,
+                              svg::Writer& writer) const {
+    RenderRoutes(layout, bus_nums, writer);
+    RenderRouteNames(layout, label_nums, writer);
+    RenderStopSymbols(layout, stop_nums, writer);
+    RenderStopNames(layout, stop_nums, writer);
+}
+
+const svg::Color& MapRenderer::GetPaletteColor(size_t bus_num) const {
+    return render_settings_.color_palette.at(bus_num % render_settings_.color_palette.size());
 }
 
-void RouteName::Draw(svg::ObjectContainer& container) const {
-    svg::Text substrate;
-    svg::Text inscript;
-    svg::Point offset(render_settings_.bus_label_offset.first, render_settings_.bus_label_offset.second);
+// Отрисовка маршрутов. Оформление линии зависит только от цвета палитры, поэтому атрибуты
+// записываются по разу на цвет
+void MapRenderer::RenderRoutes(const Layout& layout, const std::vector<uint32_t>& bus_nums, svg::Writer& writer) const {
+    std::vector<std::string> route_attrs;
+    for (size_t colar_num = 0; colar_num < layout.buses.size() && colar_num < render_settings_.color_palette.size(); ++colar_num) {
+        svg::PathStyle style;
+        style.SetFillColor(svg::NoneColor);
+        style.SetStrokeColor(GetPaletteColor(colar_num));
+        style.SetStrokeWidth(render_settings_.line_width);
+        style.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
+        style.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+        route_attrs.push_back(style.RenderAttrs());
+    }
 
+    for (const uint32_t bus_num : bus_nums) {
+        writer.StartPolyline();
+        for (auto stop : layout.buses[bus_num]->stops) {
+            writer.AddPolylinePoint(layout.projector(stop->coordinates));
+        }
+        writer.EndPolyline(route_attrs[bus_num % route_attrs.size()]);
+    }
+}
+
+// Отрисовка названий маршрутов у конечных остановок: подложка и надпись цветом маршрута
+void MapRenderer::RenderRouteNames(const Layout& layout, const std::vector<uint32_t>& label_nums, svg::Writer& writer) const {
+    svg::PathStyle substrate;
     substrate.SetFillColor(render_settings_.underlayer_color);
     substrate.SetStrokeColor(render_settings_.underlayer_color);
     substrate.SetStrokeWidth(render_settings_.underlayer_width);
     substrate.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
     substrate.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-    substrate.SetPosition(stop_);
-    substrate.SetOffset(offset);
-    substrate.SetFontSize(render_settings_.bus_label_font_size);
-    substrate.SetFontFamily("Verdana");
-    substrate.SetFontWeight("bold");
-    substrate.SetData(bus_->busname);
+    const std::string substrate_attrs = substrate.RenderAttrs();
 
-    inscript.SetFillColor(render_settings_.color_palette.at(colar_num_ % render_settings_.color_palette.size()));
-    inscript.SetPosition(stop_);
-    inscript.SetOffset(offset);
-    inscript.SetFontSize(render_settings_.bus_label_font_size);
-    inscript.SetFontFamily("Verdana");
-    inscript.SetFontWeight("bold");
-    inscript.SetData(bus_->busname);
+    std::vector<std::string> inscript_attrs;
+    for (size_t colar_num = 0; colar_num < layout.buses.size() && colar_num < render_settings_.color_palette.size(); ++colar_num) {
+        svg::PathStyle inscript;
+        inscript.SetFillColor(GetPaletteColor(colar_num));
+        inscript_attrs.push_back(inscript.RenderAttrs());
+    }
 
-    container.Add(substrate);
-    container.Add(inscript);
+    const svg::Point offset(render_settings_.bus_label_offset.first, render_settings_.bus_label_offset.second);
+    const uint32_t font_size = static_cast<uint32_t>(render_settings_.bus_label_font_size);
+    for (const uint32_t label_num : label_nums) {
+        const RouteLabel& label = layout.route_labels[label_num];
+        const std::string& busname = layout.buses[label.bus_num]->busname;
+        const svg::Point position = layout.projector(label.stop->coordinates);
+        writer.AddText(position, offset, font_size, "Verdana", "bold", busname, substrate_attrs);
+        writer.AddText(position, offset, font_size, "Verdana", "bold", busname,
+                       inscript_attrs[label.bus_num % inscript_attrs.size()]);
+    }
 }
 
-void StopSymbol::Draw(svg::ObjectContainer& container) const {
-    svg::Circle stop_symbol;
-
-    stop_symbol.SetCenter(stop_);
-    stop_symbol.SetRadius(render_settings_.stop_radius);
-    stop_symbol.SetFillColor(svg::Color{"white"});
+// Отрисовка сиволов остановок
+void MapRenderer::RenderStopSymbols(const Layout& layout, const std::vector<uint32_t>& stop_nums, svg::Writer& writer) const {
+    svg::PathStyle style;
+    style.SetFillColor(svg::Color{"white"});
+    const std::string attrs = style.RenderAttrs();
 
-    container.Add(stop_symbol);
+    for (const uint32_t stop_num : stop_nums) {
+        writer.AddCircle(layout.projector(layout.stops[stop_num]->coordinates), render_settings_.stop_radius, attrs);
+    }
 }
 
-void StopName::Draw(svg::ObjectContainer& container) const {
-    svg::Text substrate;
-    svg::Text inscript;
-    svg::Point offset(render_settings_.stop_label_offset.first, render_settings_.stop_label_offset.second);
-
-    substrate.SetPosition(position_);
-    substrate.SetOffset(offset);
-    substrate.SetFontSize(render_settings_.stop_label_font_size);
-    substrate.SetFontFamily("Verdana");
-    substrate.SetData(stopname_);
+// Отрисовка названия остановок: подложка и чёрная надпись
+void MapRenderer::RenderStopNames(const Layout& layout, const std::vector<uint32_t>& stop_nums, svg::Writer& writer) const {
+    svg::PathStyle substrate;
     substrate.SetFillColor(render_settings_.underlayer_color);
     substrate.SetStrokeColor(render_settings_.underlayer_color);
     substrate.SetStrokeWidth(render_settings_.underlayer_width);
     substrate.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
     substrate.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+    const std::string substrate_attrs = substrate.RenderAttrs();
 
-    inscript.SetPosition(position_);
-    inscript.SetOffset(offset);
-    inscript.SetFontSize(render_settings_.stop_label_font_size);
-    inscript.SetFontFamily("Verdana");
-    inscript.SetData(stopname_);
+    svg::PathStyle inscript;
     inscript.SetFillColor(svg::Color{"black"});
-
-    container.Add(substrate);
-    container.Add(inscript);
+    const std::string inscript_attrs = inscript.RenderAttrs();
+
+    const svg::Point offset(render_settings_.stop_label_offset.first, render_settings_.stop_label_offset.second);
+    const uint32_t font_size = static_cast<uint32_t>(render_settings_.stop_label_font_size);
+    for (const uint32_t stop_num : stop_nums) {
+        const Stop* stop = layout.stops[stop_num];
+        const svg::Point position = layout.projector(stop->coordinates);
+        writer.AddText(position, offset, font_size, "Verdana", "", stop->stopname, substrate_attrs);
+        writer.AddText(position, offset, font_size, "Verdana", "", stop->stopname, inscript_attrs);
+    }
 }
 
-} //rendere
-
-
+} //renderer
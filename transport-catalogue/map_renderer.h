@@ -3,6 +3,7 @@
 #include "geo.h"
 #include "svg.h"
 #include "domain.h"
+#include "grid_index.h"
 
 #include <algorithm>
 #include <cstdlib>
@@ -10,6 +11,8 @@
 #include <optional>
 #include <vector>
 #include <memory>
+#include <string>
+#include <string_view>
 
 namespace renderer {
 
@@ -54,88 +57,6 @@ private:
     double zoom_coeff_ = 0;
 };
 
-class Route : public svg::Drawable {
-public:
-    Route(const std::vector<svg::Point> stops, RenderSettings& render_settings, size_t colar_num)
-        : stops_(stops)
-        , render_settings_(render_settings)
-        , colar_num(colar_num) {
-    }
-
-    // Реализует метод Draw интерфейса svg::Drawable
-    void Draw(svg::ObjectContainer& container) const override;
-
-private:
-    const std::vector<svg::Point> stops_;
-    RenderSettings& render_settings_;
-    size_t colar_num;
-};
-
-class RouteName : public svg::Drawable {
-public:
-    RouteName(const Bus* bus, svg::Point stop, RenderSettings& render_settings, size_t colar_num)
-        : bus_(bus)
-        , stop_(stop)
-        , render_settings_(render_settings)
-        , colar_num_(colar_num) {
-    }
-
-    // Реализует метод Draw интерфейса svg::Drawable
-    void Draw(svg::ObjectContainer& container) const override;
-
-private:
-    const Bus* bus_;
-    svg::Point stop_;
-    RenderSettings& render_settings_;
-    size_t colar_num_;
-};
-
-class StopSymbol : public svg::Drawable {
-public:
-    StopSymbol(svg::Point stop, RenderSettings& render_settings)
-        : stop_(stop)
-        , render_settings_(render_settings) {
-    }
-
-    // Реализует метод Draw интерфейса svg::Drawable
-    void Draw(svg::ObjectContainer& container) const override;
-
-private:
-    svg::Point stop_;
-    RenderSettings& render_settings_;
-};
-
-class StopName : public svg::Drawable {
-public:
-    StopName(const std::string& stopname, svg::Point position, RenderSettings& render_settings)
-        : stopname_(stopname)
-        , position_(position)
-        , render_settings_(render_settings) {
-    }
-
-    // Реализует метод Draw интерфейса svg::Drawable
-    void Draw(svg::ObjectContainer& container) const override;
-
-private:
-    const std::string& stopname_;
-    svg::Point position_;
-    RenderSettings& render_settings_;
-};
-
-
-template <typename DrawableIterator>
-void DrawPicture(DrawableIterator begin, DrawableIterator end, svg::ObjectContainer& target) {
-    for (auto it = begin; it != end; ++it) {
-        (*it)->Draw(target);
-    }
-}
-
-template <typename Container>
-void DrawPicture(const Container& container, svg::ObjectContainer& target) {
-    using namespace std;
-    DrawPicture(begin(container), end(container), target);
-}
-
 class MapRenderer {
 
 public:
@@ -149,17 +70,79 @@ public:
     void SetBuses(std::vector<const Bus*> buses);
     void SetStops(std::vector<const Stop*> stops);
     void SetCoordinates(std::vector<geo::Coordinates> coords);
-    void RenderRoute();
 
-    svg::Document RenderMap();
+    //Отрисовка карты в формате SVG: элементы записываются прямо в строку через svg::Writer
+    std::string RenderMap() const;
+
+    //Отрисовка части карты: маршруты, надписи и остановки, которые пересекают область viewport,
+    //в координатах всей карты. Атрибут viewBox ограничивает изображение этой областью.
+    //Элементы ищутся в индексе, построенном BuildIndex
+    std::string RenderMap(const Rect& viewport) const;
+
+    //Пространственный индекс маршрутов, надписей и остановок для отрисовки частей карты
+    void BuildIndex();
+    bool HasIndex() const;
+
+    //Область тайла z/x/y: карта делится на 2^z × 2^z равных частей, x — номер столбца, y — номер строки
+    Rect GetTileViewport(uint32_t z, uint32_t x, uint32_t y) const;
+    //Область карты между географическими координатами углов. Нужен индекс
+    Rect GetGeoViewport(geo::Coordinates min, geo::Coordinates max) const;
+
+    //Готовая карта в формате SVG: справочник не меняется после создания базы, поэтому карта
+    //отрисовывается один раз. Пустая строка — карта ещё не отрисована
+    void SetSvg(std::string svg);
+    const std::string& GetSvg() const;
 
     RenderSettings render_settings_;
 private:
-    std::vector<std::unique_ptr<svg::Drawable>> map_;
+    //Надпись с названием маршрута у конечной остановки
+    struct RouteLabel {
+        size_t bus_num = 0;
+        const Stop* stop = nullptr;
+    };
+
+    //Всё, что нужно для отрисовки: маршруты и остановки в порядке вывода, проекция и надписи маршрутов
+    struct Layout {
+        SphereProjector projector;
+        std::vector<const Bus*> buses;
+        std::vector<const Stop*> stops;
+        std::vector<RouteLabel> route_labels;
+    };
+
+    //Индекс хранит свою раскладку, поэтому части карты рисуются без обращения к SetBuses и SetStops
+    struct MapIndex {
+        Layout layout;
+        GridIndex routes;
+        GridIndex route_labels;
+        GridIndex stops;
+    };
+
+    std::string svg_;
     std::vector<const Bus*> buses_;
     std::vector<const Stop*> stops_;
     std::vector<geo::Coordinates> coordinates_;
+    std::unique_ptr<const MapIndex> index_;
+
+    //Наибольшее число ячеек индекса по каждой стороне карты
+    static constexpr size_t MAX_CELLS_PER_SIDE = 1024;
+
+    Layout MakeLayout() const;
+
+    //Цвет палитры для маршрута с номером bus_num
+    const svg::Color& GetPaletteColor(size_t bus_num) const;
+
+    //Прямоугольник, за который не выходит надпись: ширина символа не больше размера шрифта
+    Rect GetLabelRect(svg::Point position, std::pair<double, double> offset, size_t font_size,
+                      std::string_view text) const;
 
+    //Отрисовка выбранных элементов раскладки; номера элементов идут по возрастанию
+    void RenderParts(const Layout& layout, const std::vector<uint32_t>& bus_nums,
+                     const std::vector<uint32_t>& label_nums, const std::vector<uint32_t>& stop_nums,
+                     svg::Writer& writer) const;
+    void RenderRoutes(const Layout& layout, const std::vector<uint32_t>& bus_nums, svg::Writer& writer) const;
+    void RenderRouteNames(const Layout& layout, const std::vector<uint32_t>& label_nums, svg::Writer& writer) const;
+    void RenderStopSymbols(const Layout& layout, const std::vector<uint32_t>& stop_nums, svg::Writer& writer) const;
+    void RenderStopNames(const Layout& layout, const std::vector<uint32_t>& stop_nums, svg::Writer& writer) const;
 };
 
 
@@ -0,0 +1,64 @@
+#include "mapped_file.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TC_HAS_MMAP 1
+#endif
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+#ifdef TC_HAS_MMAP
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat file_stat {};
+        if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+            void* address = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            if (address != MAP_FAILED) {
+                data_ = static_cast<const char*>(address);
+                size_ = static_cast<size_t>(file_stat.st_size);
+                is_mapped_ = true;
+            }
+        }
+        close(fd);
+    }
+    if (is_mapped_) {
+        return;
+    }
+#endif
+    ReadWholeFile(path);
+}
+
+MappedFile::~MappedFile() {
+#ifdef TC_HAS_MMAP
+    if (is_mapped_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+}
+
+const char* MappedFile::GetData() const {
+    return data_;
+}
+
+size_t MappedFile::GetSize() const {
+    return size_;
+}
+
+bool MappedFile::IsMapped() const {
+    return is_mapped_;
+}
+
+void MappedFile::ReadWholeFile(const std::filesystem::path& path) {
+    std::ifstream in_file(path, std::ios::binary);
+    if (!in_file) {
+        throw std::runtime_error("Failed to open file " + path.string());
+    }
+    buffer_.assign(std::istreambuf_iterator<char>(in_file), std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
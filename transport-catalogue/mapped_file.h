@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+
+// Файл, отображённый в память только для чтения. Страницы отображения общие
+// для всех процессов, открывших тот же файл. Там, где mmap недоступен или
+// не сработал, содержимое файла читается в память целиком
+class MappedFile {
+public:
+    explicit MappedFile(const std::filesystem::path& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    const char* GetData() const;
+    size_t GetSize() const;
+
+    bool IsMapped() const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool is_mapped_ = false;
+    std::vector<char> buffer_;
+
+    void ReadWholeFile(const std::filesystem::path& path);
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <iterator>
 #include <string_view>
 #include <unordered_map>
@@ -33,4 +34,43 @@ auto AsRange(const C& container) {
     return Range{container.begin(), container.end()};
 }
 
+// Итератор по последовательным целым числам, не хранящий самих чисел
+class IndexIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = size_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const size_t*;
+    using reference = size_t;
+
+    explicit IndexIterator(size_t index)
+        : index_(index) {
+    }
+    size_t operator*() const {
+        return index_;
+    }
+    IndexIterator& operator++() {
+        ++index_;
+        return *this;
+    }
+    IndexIterator operator++(int) {
+        IndexIterator prev = *this;
+        ++index_;
+        return prev;
+    }
+    bool operator==(const IndexIterator& other) const {
+        return index_ == other.index_;
+    }
+    bool operator!=(const IndexIterator& other) const {
+        return index_ != other.index_;
+    }
+
+private:
+    size_t index_;
+};
+
+inline Range<IndexIterator> Indices(size_t begin, size_t end) {
+    return Range{IndexIterator{begin}, IndexIterator{end}};
+}
+
 }  // namespace ranges
\ No newline at end of file
@@ -4,12 +4,16 @@ RequestHandler::RequestHandler(const TransportCatalogue& db, renderer::MapRender
     : db_(db), renderer_(renderer) {
 }
 
-svg::Document RequestHandler::RenderMap() const {
+std::string RequestHandler::RenderMap() const {
     LoadBusesAndCoordinates();
-    renderer_.RenderRoute();
     return renderer_.RenderMap();
 }
 
+void RequestHandler::BuildMapIndex() const {
+    LoadBusesAndCoordinates();
+    renderer_.BuildIndex();
+}
+
 void RequestHandler::LoadBusesAndCoordinates() const {
     std::vector<const Bus*> buses;
     std::set<const Stop*> stops_set;
@@ -13,7 +13,10 @@
 class RequestHandler {
 public:
     RequestHandler(const TransportCatalogue& db, renderer::MapRenderer& renderer);
-    svg::Document RenderMap() const;
+    //Карта в формате SVG
+    std::string RenderMap() const;
+    //Индекс для отрисовки частей карты
+    void BuildMapIndex() const;
 
 private:
     // RequestHandler использует агрегацию объектов "Транспортный Справочник" и "Визуализатор Карты"
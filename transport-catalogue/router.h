@@ -1,11 +1,14 @@
 #pragma once
 
 #include "graph.h"
+#include "thread_pool.h"
 
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <iterator>
+#include <limits>
+#include <memory>
 #include <optional>
 #include <stdexcept>
 #include <unordered_map>
@@ -14,120 +17,228 @@
 
 namespace graph {
 
+// Общий интерфейс алгоритмов поиска маршрута в графе
 template <typename Weight>
-class Router {
-private:
-    using Graph = DirectedWeightedGraph<Weight>;
-
+class RouterBase {
 public:
-    struct RouteInternalData {
+    struct RouteInfo {
         Weight weight;
-        std::optional<EdgeId> prev_edge;
+        std::vector<EdgeId> edges;
     };
 
-    using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+    virtual std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const = 0;
 
-    explicit Router(const Graph& graph);
-    explicit Router(Graph& graph, RoutesInternalData& routes_internal_data_);
+    virtual ~RouterBase() = default;
+};
 
-    struct RouteInfo {
-        Weight weight;
-        std::vector<EdgeId> edges;
+// Маршрутизатор с предрасчётом кратчайших путей между всеми парами вершин (Флойд-Уоршелл)
+template <typename Weight>
+class Router : public RouterBase<Weight> {
+private:
+    using Graph = CsrGraph<Weight>;
+
+public:
+    using typename RouterBase<Weight>::RouteInfo;
+
+    // Таблица кратчайших маршрутов между всеми парами вершин: веса и последние рёбра маршрутов
+    // лежат в двух непрерывных массивах по строкам (строка на вершину-источник).
+    // Отсутствие маршрута — бесконечный вес, отсутствие последнего ребра — NO_EDGE
+    struct RoutesInternalData {
+        size_t vertex_count = 0;
+        std::vector<Weight> weights;
+        std::vector<uint32_t> prev_edges;
+    };
+
+    // Та же таблица поверх чужой памяти только для чтения (например, отображённого в память файла базы).
+    // holder владеет памятью, на которую указывают weights и prev_edges
+    struct RoutesView {
+        size_t vertex_count = 0;
+        const Weight* weights = nullptr;
+        const uint32_t* prev_edges = nullptr;
+        std::shared_ptr<const void> holder;
     };
 
-    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    static constexpr uint32_t NO_EDGE = std::numeric_limits<uint32_t>::max();
+    static constexpr Weight INFINITE_WEIGHT = std::numeric_limits<Weight>::infinity();
 
-    RoutesInternalData& GetRoutesInternalData();
+    // Таблица считается в пуле thread_pool, без пула — в вызывающем потоке. Конструктор нельзя
+    // вызывать из задачи того же пула: задача ждала бы задачи, стоящие в очереди за ней
+    explicit Router(const Graph& graph, ThreadPool* thread_pool = nullptr);
+    explicit Router(const Graph& graph, RoutesInternalData routes_internal_data);
+    explicit Router(const Graph& graph, RoutesView routes);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+    const RoutesView& GetRoutes() const;
 
 private:
+    // Сторона квадратного блока матрицы: блок весов double занимает 32 КБ
+    static constexpr size_t BLOCK_SIZE = 64;
 
-    void InitializeRoutesInternalData(const Graph& graph) {
+    static RoutesInternalData InitializeRoutesInternalData(const Graph& graph) {
+        static_assert(std::numeric_limits<Weight>::has_infinity, "Weight should have an infinity value");
+        if (graph.GetEdgeCount() >= NO_EDGE) {
+            throw std::length_error("Too many edges for the routes matrix");
+        }
         const size_t vertex_count = graph.GetVertexCount();
+        RoutesInternalData matrix{vertex_count,
+                            std::vector<Weight>(vertex_count * vertex_count, INFINITE_WEIGHT),
+                            std::vector<uint32_t>(vertex_count * vertex_count, NO_EDGE)};
         for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-            routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
+            matrix.weights[vertex * vertex_count + vertex] = ZERO_WEIGHT;
             for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
-                const auto& edge = graph.GetEdge(edge_id);
+                const auto edge = graph.GetEdge(edge_id);
                 if (edge.weight < ZERO_WEIGHT) {
                     throw std::domain_error("Edges' weights should be non-negative");
                 }
-                auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                    route_internal_data = RouteInternalData{edge.weight, edge_id};
+                const size_t cell = vertex * vertex_count + edge.to;
+                if (matrix.weights[cell] > edge.weight) {
+                    matrix.weights[cell] = edge.weight;
+                    matrix.prev_edges[cell] = static_cast<uint32_t>(edge_id);
                 }
             }
         }
+        return matrix;
     }
 
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-                    const RouteInternalData& route_to) {
-        auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-        const Weight candidate_weight = route_from.weight + route_to.weight;
-        if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-            route_relaxing = {candidate_weight,
-                              route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
+    // Релаксация маршрутов блока (block_from, block_to) через вершины блока block_through
+    static void RelaxBlock(RoutesInternalData& matrix, size_t block_from, size_t block_to, size_t block_through) {
+        const size_t n = matrix.vertex_count;
+        const size_t from_end = std::min(n, (block_from + 1) * BLOCK_SIZE);
+        const size_t to_begin = block_to * BLOCK_SIZE;
+        const size_t to_end = std::min(n, to_begin + BLOCK_SIZE);
+        const size_t through_end = std::min(n, (block_through + 1) * BLOCK_SIZE);
+
+        Weight* const weights = matrix.weights.data();
+        uint32_t* const prev_edges = matrix.prev_edges.data();
+        for (VertexId through = block_through * BLOCK_SIZE; through < through_end; ++through) {
+            const Weight* const weights_through = weights + through * n;
+            const uint32_t* const prev_edges_through = prev_edges + through * n;
+            for (VertexId from = block_from * BLOCK_SIZE; from < from_end; ++from) {
+                const Weight weight_from = weights[from * n + through];
+                if (weight_from == INFINITE_WEIGHT) {
+                    continue;
+                }
+                Weight* const weights_row = weights + from * n;
+                uint32_t* const prev_edges_row = prev_edges + from * n;
+                // Маршрут через through в саму through не короче текущего, поэтому последнее ребро
+                // улучшенного маршрута всегда берётся из строки through. Без ветвлений цикл векторизуется
+                for (VertexId to = to_begin; to < to_end; ++to) {
+                    const Weight candidate_weight = weight_from + weights_through[to];
+                    const bool is_shorter = candidate_weight < weights_row[to];
+                    weights_row[to] = is_shorter ? candidate_weight : weights_row[to];
+                    prev_edges_row[to] = is_shorter ? prev_edges_through[to] : prev_edges_row[to];
+                }
+            }
         }
     }
 
-    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-        for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-            if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                    if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                        RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
+    // Блочный алгоритм Флойда-Уоршелла. Для каждого ведущего блока k: сначала блок (k, k),
+    // затем независимые блоки строки и столбца k, затем все остальные блоки — по строкам в пуле потоков
+    static void ComputeRoutesInternalData(RoutesInternalData& matrix, ThreadPool* thread_pool) {
+        const size_t block_count = (matrix.vertex_count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        auto parallel_for = [thread_pool](size_t count, auto func) {
+            if (thread_pool != nullptr) {
+                thread_pool->ParallelFor(count, func);
+                return;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                func(i);
+            }
+        };
+        for (size_t block_through = 0; block_through < block_count; ++block_through) {
+            RelaxBlock(matrix, block_through, block_through, block_through);
+
+            parallel_for(block_count, [&matrix, block_through](size_t block) {
+                if (block != block_through) {
+                    RelaxBlock(matrix, block_through, block, block_through);
+                    RelaxBlock(matrix, block, block_through, block_through);
+                }
+            });
+
+            parallel_for(block_count, [&matrix, block_through, block_count](size_t block_from) {
+                if (block_from == block_through) {
+                    return;
+                }
+                for (size_t block_to = 0; block_to < block_count; ++block_to) {
+                    if (block_to != block_through) {
+                        RelaxBlock(matrix, block_from, block_to, block_through);
                     }
                 }
-            }
+            });
         }
     }
 
     static constexpr Weight ZERO_WEIGHT{};
     const Graph& graph_;
-    RoutesInternalData routes_internal_data_;
+    RoutesView routes_;
+
+    static RoutesView MakeRoutesView(RoutesInternalData routes_internal_data) {
+        auto holder = std::make_shared<const RoutesInternalData>(std::move(routes_internal_data));
+        return {holder->vertex_count, holder->weights.data(), holder->prev_edges.data(), holder};
+    }
 };
 
 template <typename Weight>
-Router<Weight>::Router(const Graph& graph)
+Router<Weight>::Router(const Graph& graph, ThreadPool* thread_pool)
     : graph_(graph)
-    , routes_internal_data_(graph.GetVertexCount(),
-                            std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
 {
-    InitializeRoutesInternalData(graph);
+    RoutesInternalData routes_internal_data = InitializeRoutesInternalData(graph);
+    ComputeRoutesInternalData(routes_internal_data, thread_pool);
+    routes_ = MakeRoutesView(std::move(routes_internal_data));
+}
 
-    const size_t vertex_count = graph.GetVertexCount();
-    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+template<typename Weight>
+Router<Weight>::Router(const Graph& graph, RoutesInternalData routes_internal_data)
+    : graph_(graph)
+{
+    const size_t cell_count = routes_internal_data.vertex_count * routes_internal_data.vertex_count;
+    if (routes_internal_data.vertex_count != graph.GetVertexCount()
+        || routes_internal_data.weights.size() != cell_count
+        || routes_internal_data.prev_edges.size() != cell_count) {
+        throw std::invalid_argument("Routes internal data doesn't match the graph");
     }
+    routes_ = MakeRoutesView(std::move(routes_internal_data));
 }
 
 template<typename Weight>
-inline Router<Weight>::Router(Graph& graph, RoutesInternalData& routes_internal_data)
+Router<Weight>::Router(const Graph& graph, RoutesView routes)
     : graph_(graph)
-    , routes_internal_data_(routes_internal_data) {
+    , routes_(std::move(routes))
+{
+    if (routes_.vertex_count != graph.GetVertexCount()
+        || (routes_.vertex_count != 0 && (routes_.weights == nullptr || routes_.prev_edges == nullptr))) {
+        throw std::invalid_argument("Routes view doesn't match the graph");
+    }
 }
 
 template <typename Weight>
 std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
                                                                              VertexId to) const {
-    const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-    if (!route_internal_data) {
+    const size_t vertex_count = routes_.vertex_count;
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    const Weight* const weights_row = routes_.weights + from * vertex_count;
+    const uint32_t* const prev_edges_row = routes_.prev_edges + from * vertex_count;
+    if (weights_row[to] == INFINITE_WEIGHT) {
         return std::nullopt;
     }
-    const Weight weight = route_internal_data->weight;
     std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-         edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+    for (uint32_t edge_id = prev_edges_row[to];
+         edge_id != NO_EDGE;
+         edge_id = prev_edges_row[graph_.GetEdge(edge_id).from])
     {
-        edges.push_back(*edge_id);
+        edges.push_back(edge_id);
     }
     std::reverse(edges.begin(), edges.end());
 
-    return RouteInfo{weight, std::move(edges)};
+    return RouteInfo{weights_row[to], std::move(edges)};
 }
 
 template <typename Weight>
-typename Router<Weight>::RoutesInternalData& Router<Weight>::GetRoutesInternalData() {
-    return routes_internal_data_;
+const typename Router<Weight>::RoutesView& Router<Weight>::GetRoutes() const {
+    return routes_;
 }
 
 }  // namespace graph
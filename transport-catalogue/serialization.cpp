@@ -1,66 +1,258 @@
 #include "serialization.h"
 
-proto_info::ProtoInfo::ProtoInfo(TransportCatalogue& db,
-                                 renderer::MapRenderer& renderer, TransportRouter& route) {
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+
+namespace {
+
+constexpr size_t SECTION_COUNT = static_cast<size_t>(proto_info::BaseSection::COUNT);
+
+//Заголовок в начале файла базы: оглавление секций по номерам BaseSection. Числа записаны
+//в порядке байт машины, создавшей базу
+struct BaseFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    proto_info::SectionEntry sections[SECTION_COUNT];
+};
+
+static_assert(std::is_trivially_copyable_v<BaseFileHeader>);
+
+constexpr char BASE_FILE_MAGIC[8] = {'T', 'C', 'B', 'A', 'S', 'E', '\0', '\0'};
+//Версия 2: некольцевые маршруты хранят только путь в одну сторону.
+//Версия 3: расстояния по дорогам не записываются: они нужны только для расчёта статистики
+//и маршрутизатора, которые сохраняются в базе готовыми.
+//Версия 4: база разбита на секции, которые читаются независимо
+constexpr uint32_t BASE_FILE_VERSION = 4;
+constexpr uint32_t BASE_FILE_BYTE_ORDER = 0x01020304;
+//Выравнивание секции таблицы маршрутов: её страницы отображаются без копирования
+constexpr uint64_t ROUTES_ALIGNMENT = 4096;
+
+uint64_t AlignUp(uint64_t offset, uint64_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+proto_info::ProtoInfo::~ProtoInfo() {
+    if (out_file_.is_open()) {
+        out_file_.close();
+        std::error_code error;
+        std::filesystem::remove(temp_path_, error);
+    }
+}
+
+//Место под заголовок заполняется нулями: пока запись не завершена, файл не читается как база
+void proto_info::ProtoInfo::BeginSerialization(const std::filesystem::path& path) {
+    out_path_ = path;
+    temp_path_ = path;
+    temp_path_ += ".tmp";
+    out_file_.open(temp_path_, std::ios::binary | std::ios::trunc);
+    const BaseFileHeader header{};
+    out_file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write_offset_ = sizeof(header);
+    sections_ = {};
+}
+
+void proto_info::ProtoInfo::EndSerialization() {
+    BaseFileHeader header{};
+    std::memcpy(header.magic, BASE_FILE_MAGIC, sizeof(header.magic));
+    header.version = BASE_FILE_VERSION;
+    header.byte_order = BASE_FILE_BYTE_ORDER;
+    std::copy(sections_.begin(), sections_.end(), header.sections);
+
+    out_file_.seekp(0);
+    out_file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_file_.close();
+    //Готовый файл заменяет старую базу одним переименованием, старый файл остаётся у тех,
+    //кто его открыл
+    std::error_code error;
+    if (out_file_) {
+        std::filesystem::rename(temp_path_, out_path_, error);
+    }
+    if (!out_file_ || error) {
+        std::filesystem::remove(temp_path_, error);
+        throw std::runtime_error("Failed to write base file " + out_path_.string());
+    }
+}
+
+void proto_info::ProtoInfo::WriteCatalogue(TransportCatalogue& db) {
     AddStops(db);
-    AddDistance(db);
     AddBuses(db);
+    WriteSection(BaseSection::CATALOGUE, t_catalogue_);
+}
+
+void proto_info::ProtoInfo::WriteBusStats(TransportCatalogue& db) {
+    AddBusStats(db);
+    WriteSection(BaseSection::BUS_STATS, bus_stats_);
+}
+
+void proto_info::ProtoInfo::WriteMap(renderer::MapRenderer& renderer) {
     AddMap(renderer);
+    WriteSection(BaseSection::RENDER_SETTINGS, map_);
+    WriteSection(BaseSection::SVG, std::string_view(renderer.GetSvg()));
+}
+
+//Таблица маршрутов выравнивается по странице и пишется прямо из памяти маршрутизатора
+void proto_info::ProtoInfo::WriteRouter(TransportRouter& route) {
     AddRoute(route);
+    WriteSection(BaseSection::ROUTER, transport_router_);
+    if (routes_.weights == nullptr) {
+        return;
+    }
+    const size_t cell_count = routes_.vertex_count * routes_.vertex_count;
+    std::lock_guard lock(write_mutex_);
+    const uint64_t offset = AlignUp(write_offset_, ROUTES_ALIGNMENT);
+    const std::string padding(offset - write_offset_, '\0');
+    out_file_.write(padding.data(), padding.size());
+    out_file_.write(reinterpret_cast<const char*>(routes_.weights), cell_count * sizeof(double));
+    out_file_.write(reinterpret_cast<const char*>(routes_.prev_edges), cell_count * sizeof(uint32_t));
+    sections_[static_cast<size_t>(BaseSection::ROUTES)] = {offset, cell_count * (sizeof(double) + sizeof(uint32_t))};
+    write_offset_ = offset + sections_[static_cast<size_t>(BaseSection::ROUTES)].size;
 }
 
-void proto_info::ProtoInfo::Serialization(const std::filesystem::path& path) {
-    std::ofstream out_file(path, std::ios::binary);
-    t_catalogue_.SerializeToOstream(&out_file);
+void proto_info::ProtoInfo::WriteSection(BaseSection section, std::string_view data) {
+    std::lock_guard lock(write_mutex_);
+    out_file_.write(data.data(), data.size());
+    sections_[static_cast<size_t>(section)] = {data.empty() ? 0 : write_offset_, data.size()};
+    write_offset_ += data.size();
 }
 
+//Читается только оглавление; секции разбираются по мере обращения к ним
 void proto_info::ProtoInfo::Deserialization(const std::filesystem::path& path) {
-    std::ifstream in_file(path, std::ios::binary);
-    t_catalogue_.ParseFromIstream(&in_file);
+    base_file_ = std::make_shared<const MappedFile>(path);
+
+    BaseFileHeader header{};
+    if (base_file_->GetSize() < sizeof(header)) {
+        throw std::runtime_error("Unsupported base file format");
+    }
+    std::memcpy(&header, base_file_->GetData(), sizeof(header));
+    if (std::memcmp(header.magic, BASE_FILE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != BASE_FILE_VERSION
+        || header.byte_order != BASE_FILE_BYTE_ORDER
+        || header.sections[static_cast<size_t>(BaseSection::ROUTES)].offset % alignof(double) != 0) {
+        throw std::runtime_error("Unsupported base file format");
+    }
+    for (size_t section = 0; section < SECTION_COUNT; ++section) {
+        const SectionEntry& entry = header.sections[section];
+        if (entry.offset > base_file_->GetSize() || entry.size > base_file_->GetSize() - entry.offset) {
+            throw std::runtime_error("Unsupported base file format");
+        }
+        sections_[section] = entry;
+    }
+    is_catalogue_parsed_ = false;
+}
+
+const proto_info::SectionEntry& proto_info::ProtoInfo::GetSection(BaseSection section) const {
+    return sections_[static_cast<size_t>(section)];
+}
+
+void proto_info::ProtoInfo::ParseSection(BaseSection section, google::protobuf::MessageLite& message) {
+    const SectionEntry& entry = GetSection(section);
+    if (!message.ParseFromArray(base_file_->GetData() + entry.offset, static_cast<int>(entry.size))) {
+        throw std::runtime_error("Failed to parse base file");
+    }
+}
+
+//Остановки и маршруты нужны почти всем запросам, поэтому секция каталога разбирается один раз
+const t_catalogue_proto::TransportCatalogue& proto_info::ProtoInfo::GetCatalogue() {
+    if (!is_catalogue_parsed_) {
+        ParseSection(BaseSection::CATALOGUE, t_catalogue_);
+        is_catalogue_parsed_ = true;
+    }
+    return t_catalogue_;
 }
 
 std::vector<Bus> proto_info::ProtoInfo::ParseProtoBuses(TransportCatalogue& db) {
+    const t_catalogue_proto::TransportCatalogue& catalogue = GetCatalogue();
     std::vector<Bus> result_bus;
-    result_bus.reserve(t_catalogue_.buses_size());
+    result_bus.reserve(catalogue.buses_size());
 
-    for (size_t i = 0; i < t_catalogue_.buses_size(); ++i) {
+    for (int i = 0; i < catalogue.buses_size(); ++i) {
         Bus bus;
-        bus.is_roundtrip = t_catalogue_.mutable_buses(i)->is_roundtrip();
-        bus.busname = t_catalogue_.mutable_buses(i)->bus_name();
-        for (size_t j = 0; j < t_catalogue_.mutable_buses(i)->route_size(); ++j) {
-            bus.stops.push_back(db.FindStop(t_catalogue_.mutable_buses(i)->mutable_route(j)->stop_name()));
+        bus.is_roundtrip = catalogue.buses(i).is_roundtrip();
+        bus.busname = catalogue.buses(i).bus_name();
+        const auto& stop_ids = catalogue.buses(i).stop_ids();
+        bus.stops.reserve(bus.is_roundtrip ? stop_ids.size() : std::max(stop_ids.size() * 2, 1) - 1);
+        for (const uint32_t stop_id : stop_ids) {
+            bus.stops.push_back(&db.GetStops().at(stop_id));
+        }
+        //Обратный путь некольцевого маршрута восстанавливается, как в JsonReader::ParsingBus
+        if (!bus.is_roundtrip && !bus.stops.empty()) {
+            bus.stops.insert(bus.stops.end(), std::next(bus.stops.rbegin()), bus.stops.rend());
         }
-        result_bus.push_back(bus);
+        result_bus.push_back(std::move(bus));
     }
 
     return result_bus;
 }
 
+std::vector<BusInfo> proto_info::ProtoInfo::ParseProtoBusInfos() {
+    const t_catalogue_proto::TransportCatalogue& catalogue = GetCatalogue();
+    t_catalogue_proto::BusStatsList bus_stats;
+    ParseSection(BaseSection::BUS_STATS, bus_stats);
+    if (bus_stats.buses_size() != catalogue.buses_size()) {
+        throw std::runtime_error("Failed to parse bus statistics");
+    }
+
+    std::vector<BusInfo> bus_infos;
+    bus_infos.reserve(catalogue.buses_size());
+    for (int i = 0; i < catalogue.buses_size(); ++i) {
+        const t_catalogue_proto::BusStats& proto_stats = bus_stats.buses(i);
+        BusInfo bus_info;
+        bus_info.busname = catalogue.buses(i).bus_name();
+        bus_info.stops_count = proto_stats.stops_count();
+        bus_info.uniq_stops_count = proto_stats.uniq_stops_count();
+        bus_info.route_len = proto_stats.route_length();
+        bus_info.curvature = proto_stats.curvature();
+        bus_infos.push_back(std::move(bus_info));
+    }
+
+    return bus_infos;
+}
+
 void proto_info::ProtoInfo::ParseProtoMap(renderer::MapRenderer& renderer) {
-    renderer.render_settings_.width = t_catalogue_.mutable_map()->width();
-    renderer.render_settings_.height = t_catalogue_.mutable_map()->height();
-    renderer.render_settings_.padding = t_catalogue_.mutable_map()->padding();
-    renderer.render_settings_.stop_radius = t_catalogue_.mutable_map()->stop_radius();
-    renderer.render_settings_.line_width = t_catalogue_.mutable_map()->line_width();
-    renderer.render_settings_.bus_label_font_size = t_catalogue_.mutable_map()->bus_label_font_size();
+    ParseSection(BaseSection::RENDER_SETTINGS, map_);
+    renderer.render_settings_.width = map_.width();
+    renderer.render_settings_.height = map_.height();
+    renderer.render_settings_.padding = map_.padding();
+    renderer.render_settings_.stop_radius = map_.stop_radius();
+    renderer.render_settings_.line_width = map_.line_width();
+    renderer.render_settings_.bus_label_font_size = map_.bus_label_font_size();
 
-    renderer.render_settings_.bus_label_offset.first = t_catalogue_.mutable_map()->bus_label_offset(0);
-    renderer.render_settings_.bus_label_offset.second = t_catalogue_.mutable_map()->bus_label_offset(1);
+    renderer.render_settings_.bus_label_offset.first = map_.bus_label_offset(0);
+    renderer.render_settings_.bus_label_offset.second = map_.bus_label_offset(1);
 
-    renderer.render_settings_.stop_label_font_size = t_catalogue_.mutable_map()->stop_label_font_size();
+    renderer.render_settings_.stop_label_font_size = map_.stop_label_font_size();
 
-    renderer.render_settings_.stop_label_offset.first = t_catalogue_.mutable_map()->stop_label_offset(0);
-    renderer.render_settings_.stop_label_offset.second = t_catalogue_.mutable_map()->stop_label_offset(1);
+    renderer.render_settings_.stop_label_offset.first = map_.stop_label_offset(0);
+    renderer.render_settings_.stop_label_offset.second = map_.stop_label_offset(1);
 
-    renderer.render_settings_.underlayer_width = t_catalogue_.mutable_map()->underlayer_width();
+    renderer.render_settings_.underlayer_width = map_.underlayer_width();
     AddColorOutProto(renderer);
     AddColorPaletteOutProto(renderer);
 }
 
-void proto_info::ProtoInfo::ParseProtoTransportRouter(TransportRouter& route, TransportCatalogue& db) {
+bool proto_info::ProtoInfo::HasSvg() const {
+    return GetSection(BaseSection::SVG).size != 0;
+}
+
+//Карта копируется из отображённого файла без разбора protobuf
+std::string proto_info::ProtoInfo::ParseProtoSvg() {
+    const SectionEntry& section = GetSection(BaseSection::SVG);
+    return std::string(base_file_->GetData() + section.offset, section.size);
+}
+
+void proto_info::ProtoInfo::ParseProtoTransportRouter(TransportRouter& route) {
+    ParseSection(BaseSection::ROUTER, transport_router_);
+    route.SetGraphModel(static_cast<GraphModel>(transport_router_.graph_model()));
+    route.SetRouteCacheSize(transport_router_.route_cache_size());
     ParseProtoGraph(route);
-    ParseProtoEdgeInfo(route, db);
-    ParseProtoStopnamesToId(route);
+    ParseProtoEdgeInfo(route);
     ParseProtoRouter(route);
 }
 
@@ -69,19 +261,27 @@ void proto_info::ProtoInfo::AddBuses(TransportCatalogue& db) {
         t_catalogue_proto::Bus proto_bus;
         proto_bus.set_is_roundtrip(bus.is_roundtrip);
         proto_bus.set_bus_name(bus.busname);
-        for (auto& stop : bus.stops) {
-            t_catalogue_proto::Stop proto_stop;
-            //proto_stop.set_vertex_id(stop->vertex_id);
-            proto_stop.set_stop_name(stop->stopname);
-            proto_stop.mutable_coordinates_()->set_lat(stop->coordinates.lat);
-            proto_stop.mutable_coordinates_()->set_lng(stop->coordinates.lng);
-            *proto_bus.mutable_route()->Add() = proto_stop;
+        //У некольцевого маршрута записывается только путь в одну сторону: обратный путь его повторяет
+        const size_t stop_count = bus.is_roundtrip ? bus.stops.size() : bus.stops.size() / 2 + 1;
+        proto_bus.mutable_stop_ids()->Reserve(stop_count);
+        for (size_t i = 0; i < stop_count && i < bus.stops.size(); ++i) {
+            proto_bus.add_stop_ids(bus.stops[i]->id);
         }
         *t_catalogue_.mutable_buses()->Add() = proto_bus;
     }
 }
 
-void proto_info::ProtoInfo::AddDistance(TransportCatalogue& db) {
+void proto_info::ProtoInfo::AddBusStats(TransportCatalogue& db) {
+    for (const BusInfo& bus_info : db.GetBusInfos()) {
+        t_catalogue_proto::BusStats& proto_stats = *bus_stats_.add_buses();
+        proto_stats.set_stops_count(bus_info.stops_count);
+        proto_stats.set_uniq_stops_count(bus_info.uniq_stops_count);
+        proto_stats.set_route_length(bus_info.route_len);
+        proto_stats.set_curvature(bus_info.curvature);
+    }
+}
+
+void proto_info::ProtoInfo::AddStops(TransportCatalogue& db) {
     for (auto& stop : db.GetStops()) {
         t_catalogue_proto::Stop proto_stop;
         proto_stop.set_stop_name(stop.stopname);
@@ -92,69 +292,60 @@ void proto_info::ProtoInfo::AddDistance(TransportCatalogue& db) {
     }
 }
 
-void proto_info::ProtoInfo::AddStops(TransportCatalogue& db) {
-    for (auto& [stops, distance] : db.GetDistancesToStops()) {
-        t_catalogue_proto::Dist proto_dist;
-        proto_dist.set_stop_one(stops.first->stopname);
-        proto_dist.set_stop_two(stops.second->stopname);
-        proto_dist.set_distance(distance);
-        *t_catalogue_.mutable_stops_distance()->Add() = proto_dist;
-    }
-}
-
 void proto_info::ProtoInfo::AddMap(renderer::MapRenderer& renderer) {
-    t_catalogue_.mutable_map()->set_width(renderer.render_settings_.width);
-    t_catalogue_.mutable_map()->set_height(renderer.render_settings_.height);
-    t_catalogue_.mutable_map()->set_padding(renderer.render_settings_.padding);
-    t_catalogue_.mutable_map()->set_stop_radius(renderer.render_settings_.stop_radius);
-    t_catalogue_.mutable_map()->set_line_width(renderer.render_settings_.line_width);
-    t_catalogue_.mutable_map()->set_bus_label_font_size(renderer.render_settings_.bus_label_font_size);
+    map_.set_width(renderer.render_settings_.width);
+    map_.set_height(renderer.render_settings_.height);
+    map_.set_padding(renderer.render_settings_.padding);
+    map_.set_stop_radius(renderer.render_settings_.stop_radius);
+    map_.set_line_width(renderer.render_settings_.line_width);
+    map_.set_bus_label_font_size(renderer.render_settings_.bus_label_font_size);
 
-    t_catalogue_.mutable_map()->add_bus_label_offset(renderer.render_settings_.bus_label_offset.first);
-    t_catalogue_.mutable_map()->add_bus_label_offset(renderer.render_settings_.bus_label_offset.second);
+    map_.add_bus_label_offset(renderer.render_settings_.bus_label_offset.first);
+    map_.add_bus_label_offset(renderer.render_settings_.bus_label_offset.second);
 
-    t_catalogue_.mutable_map()->set_stop_label_font_size(renderer.render_settings_.stop_label_font_size);
+    map_.set_stop_label_font_size(renderer.render_settings_.stop_label_font_size);
 
-    t_catalogue_.mutable_map()->add_stop_label_offset(renderer.render_settings_.stop_label_offset.first);
-    t_catalogue_.mutable_map()->add_stop_label_offset(renderer.render_settings_.stop_label_offset.second);
+    map_.add_stop_label_offset(renderer.render_settings_.stop_label_offset.first);
+    map_.add_stop_label_offset(renderer.render_settings_.stop_label_offset.second);
 
-    t_catalogue_.mutable_map()->set_underlayer_width(renderer.render_settings_.underlayer_width);
+    map_.set_underlayer_width(renderer.render_settings_.underlayer_width);
     AddColorInProto(renderer);
     AddColorPaletteInProto(renderer);
-
 }
 
 void proto_info::ProtoInfo::AddRoute(TransportRouter& route) {
     HelperAddGraphInProto(route);
     HelperAddEdgesInProto(route);
-    HelperAddStopnamesToIdInProto(route);
     HelperAddRouterInProto(route);
-    t_catalogue_.mutable_transport_router()->set_wait(route.GetWaitTime());
-    t_catalogue_.mutable_transport_router()->set_speed(route.GetVelocity());
+    transport_router_.set_wait(route.GetWaitTime());
+    transport_router_.set_speed(route.GetVelocity());
+    transport_router_.set_router_type(route.GetRouterType());
+    transport_router_.set_graph_model(route.GetGraphModel());
+    transport_router_.set_route_cache_size(route.GetRouteCacheSize());
 }
 
 void proto_info::ProtoInfo::AddColorInProto(renderer::MapRenderer& renderer) {
     switch (renderer.render_settings_.underlayer_color.index()) {
     case 1: {
-        t_catalogue_.mutable_map()->mutable_underlayer_color()->
+        map_.mutable_underlayer_color()->
             set_str_color(std::get<std::string>(renderer.render_settings_.underlayer_color));
         break;
     }
     case 2: {
         svg::Rgb rgb;
         rgb = std::get<svg::Rgb>(renderer.render_settings_.underlayer_color);
-        t_catalogue_.mutable_map()->mutable_underlayer_color()->mutable_rgb_color()->set_r(rgb.red);
-        t_catalogue_.mutable_map()->mutable_underlayer_color()->mutable_rgb_color()->set_g(rgb.green);
-        t_catalogue_.mutable_map()->mutable_underlayer_color()->mutable_rgb_color()->set_b(rgb.blue);
+        map_.mutable_underlayer_color()->mutable_rgb_color()->set_r(rgb.red);
+        map_.mutable_underlayer_color()->mutable_rgb_color()->set_g(rgb.green);
+        map_.mutable_underlayer_color()->mutable_rgb_color()->set_b(rgb.blue);
         break;
     }
     case 3: {
         svg::Rgba rgba;
         rgba = std::get<svg::Rgba>(renderer.render_settings_.underlayer_color);
-        t_catalogue_.mutable_map()->mutable_underlayer_color()->mutable_rgba_color()->set_r(rgba.red);
-        t_catalogue_.mutable_map()->mutable_underlayer_color()->mutable_rgba_color()->set_g(rgba.green);
-        t_catalogue_.mutable_map()->mutable_underlayer_color()->mutable_rgba_color()->set_b(rgba.blue);
-        t_catalogue_.mutable_map()->mutable_underlayer_color()->mutable_rgba_color()->set_opacity(rgba.opacity);
+        map_.mutable_underlayer_color()->mutable_rgba_color()->set_r(rgba.red);
+        map_.mutable_underlayer_color()->mutable_rgba_color()->set_g(rgba.green);
+        map_.mutable_underlayer_color()->mutable_rgba_color()->set_b(rgba.blue);
+        map_.mutable_underlayer_color()->mutable_rgba_color()->set_opacity(rgba.opacity);
         break;
     }
     default: { break; }
@@ -167,7 +358,7 @@ void proto_info::ProtoInfo::AddColorPaletteInProto(renderer::MapRenderer& render
         case 1: {
             t_catalogue_proto::Color color;
             color.set_str_color(std::get<std::string>(elem));
-            *t_catalogue_.mutable_map()->mutable_color_palette_()->Add() = color;
+            *map_.mutable_color_palette_()->Add() = color;
             break;
         }
         case 2: {
@@ -177,7 +368,7 @@ void proto_info::ProtoInfo::AddColorPaletteInProto(renderer::MapRenderer& render
             color.mutable_rgb_color()->set_r(rgb.red);
             color.mutable_rgb_color()->set_g(rgb.green);
             color.mutable_rgb_color()->set_b(rgb.blue);
-            *t_catalogue_.mutable_map()->mutable_color_palette_()->Add() = color;
+            *map_.mutable_color_palette_()->Add() = color;
             break;
         }
         case 3: {
@@ -188,7 +379,7 @@ void proto_info::ProtoInfo::AddColorPaletteInProto(renderer::MapRenderer& render
             color.mutable_rgba_color()->set_g(rgba.green);
             color.mutable_rgba_color()->set_b(rgba.blue);
             color.mutable_rgba_color()->set_opacity(rgba.opacity);
-            *t_catalogue_.mutable_map()->mutable_color_palette_()->Add() = color;
+            *map_.mutable_color_palette_()->Add() = color;
             break;
         }
         default: { break; }
@@ -197,22 +388,22 @@ void proto_info::ProtoInfo::AddColorPaletteInProto(renderer::MapRenderer& render
 }
 
 void proto_info::ProtoInfo::AddColorOutProto(renderer::MapRenderer& renderer) {
-    if (t_catalogue_.mutable_map()->mutable_underlayer_color()->col_case() == 1) {
-        renderer.render_settings_.underlayer_color = t_catalogue_.mutable_map()->mutable_underlayer_color()->str_color();
+    if (map_.mutable_underlayer_color()->col_case() == 1) {
+        renderer.render_settings_.underlayer_color = map_.mutable_underlayer_color()->str_color();
     }
-    else if (t_catalogue_.mutable_map()->mutable_underlayer_color()->col_case() == 2) {
+    else if (map_.mutable_underlayer_color()->col_case() == 2) {
         svg::Rgb rgb;
-        rgb.red = t_catalogue_.mutable_map()->mutable_underlayer_color()->mutable_rgb_color()->r();
-        rgb.green = t_catalogue_.mutable_map()->mutable_underlayer_color()->mutable_rgb_color()->g();
-        rgb.blue = t_catalogue_.mutable_map()->mutable_underlayer_color()->mutable_rgb_color()->b();
+        rgb.red = map_.mutable_underlayer_color()->mutable_rgb_color()->r();
+        rgb.green = map_.mutable_underlayer_color()->mutable_rgb_color()->g();
+        rgb.blue = map_.mutable_underlayer_color()->mutable_rgb_color()->b();
         renderer.render_settings_.underlayer_color = rgb;
     }
-    else if (t_catalogue_.mutable_map()->mutable_underlayer_color()->col_case() == 3) {
+    else if (map_.mutable_underlayer_color()->col_case() == 3) {
         svg::Rgba rgba;
-        rgba.red = t_catalogue_.mutable_map()->mutable_underlayer_color()->mutable_rgba_color()->r();
-        rgba.green = t_catalogue_.mutable_map()->mutable_underlayer_color()->mutable_rgba_color()->g();
-        rgba.blue = t_catalogue_.mutable_map()->mutable_underlayer_color()->mutable_rgba_color()->b();
-        rgba.opacity = t_catalogue_.mutable_map()->mutable_underlayer_color()->mutable_rgba_color()->opacity();
+        rgba.red = map_.mutable_underlayer_color()->mutable_rgba_color()->r();
+        rgba.green = map_.mutable_underlayer_color()->mutable_rgba_color()->g();
+        rgba.blue = map_.mutable_underlayer_color()->mutable_rgba_color()->b();
+        rgba.opacity = map_.mutable_underlayer_color()->mutable_rgba_color()->opacity();
         renderer.render_settings_.underlayer_color = rgba;
     }
     else {
@@ -221,23 +412,23 @@ void proto_info::ProtoInfo::AddColorOutProto(renderer::MapRenderer& renderer) {
 }
 
 void proto_info::ProtoInfo::AddColorPaletteOutProto(renderer::MapRenderer& renderer) {
-    for (size_t i = 0; i < t_catalogue_.mutable_map()->color_palette__size(); ++i) {
-        if (t_catalogue_.mutable_map()->color_palette_(i).col_case() == 1) {
-            renderer.render_settings_.color_palette.push_back(t_catalogue_.mutable_map()->mutable_color_palette_(i)->str_color());
+    for (int i = 0; i < map_.color_palette__size(); ++i) {
+        if (map_.color_palette_(i).col_case() == 1) {
+            renderer.render_settings_.color_palette.push_back(map_.mutable_color_palette_(i)->str_color());
         }
-        else if (t_catalogue_.mutable_map()->mutable_color_palette_(i)->col_case() == 2) {
+        else if (map_.mutable_color_palette_(i)->col_case() == 2) {
             svg::Rgb rgb;
-            rgb.red = t_catalogue_.mutable_map()->mutable_color_palette_(i)->mutable_rgb_color()->r();
-            rgb.green = t_catalogue_.mutable_map()->mutable_color_palette_(i)->mutable_rgb_color()->g();
-            rgb.blue = t_catalogue_.mutable_map()->mutable_color_palette_(i)->mutable_rgb_color()->b();
+            rgb.red = map_.mutable_color_palette_(i)->mutable_rgb_color()->r();
+            rgb.green = map_.mutable_color_palette_(i)->mutable_rgb_color()->g();
+            rgb.blue = map_.mutable_color_palette_(i)->mutable_rgb_color()->b();
             renderer.render_settings_.color_palette.push_back(rgb);
         }
-        else if (t_catalogue_.mutable_map()->mutable_color_palette_(i)->col_case() == 3) {
+        else if (map_.mutable_color_palette_(i)->col_case() == 3) {
             svg::Rgba rgba;
-            rgba.red = t_catalogue_.mutable_map()->mutable_color_palette_(i)->mutable_rgba_color()->r();
-            rgba.green = t_catalogue_.mutable_map()->mutable_color_palette_(i)->mutable_rgba_color()->g();
-            rgba.blue = t_catalogue_.mutable_map()->mutable_color_palette_(i)->mutable_rgba_color()->b();
-            rgba.opacity = t_catalogue_.mutable_map()->mutable_color_palette_(i)->mutable_rgba_color()->opacity();
+            rgba.red = map_.mutable_color_palette_(i)->mutable_rgba_color()->r();
+            rgba.green = map_.mutable_color_palette_(i)->mutable_rgba_color()->g();
+            rgba.blue = map_.mutable_color_palette_(i)->mutable_rgba_color()->b();
+            rgba.opacity = map_.mutable_color_palette_(i)->mutable_rgba_color()->opacity();
             renderer.render_settings_.color_palette.push_back(rgba);
         }
         else {
@@ -247,176 +438,133 @@ void proto_info::ProtoInfo::AddColorPaletteOutProto(renderer::MapRenderer& rende
 }
 
 void proto_info::ProtoInfo::HelperAddGraphInProto(TransportRouter& route) {
-    for (size_t i = 0; i < route.GetGraph().GetEdges().size(); ++i) {
-        t_catalogue_proto::Edge edge;
-        edge.set_from(route.GetGraph().GetEdges()[i].from);
-        edge.set_to(route.GetGraph().GetEdges()[i].to);
-        edge.set_weight(route.GetGraph().GetEdges()[i].weight);
-        *t_catalogue_.mutable_transport_router()->mutable_graph()->mutable_edges()->Add() = edge;
-    }
-
-    for (size_t i = 0; i < route.GetGraph().GetIncidenceLists().size(); ++i) {
-        t_catalogue_proto::IncidenceList incidence_list;
-        for (size_t j = 0; j < route.GetGraph().GetIncidenceLists()[i].size(); ++j) {
-            *incidence_list.mutable_list()->Add() = route.GetGraph().GetIncidenceLists()[i][j];
-        }
-        *t_catalogue_.mutable_transport_router()->mutable_graph()->mutable_incidence_lists()->Add() = incidence_list;
-    }
+    const graph::CsrGraph<double>& graph = route.GetGraph();
+    auto& proto_graph = *transport_router_.mutable_graph();
+    proto_graph.mutable_offsets()->Add(graph.GetOffsets().begin(), graph.GetOffsets().end());
+    proto_graph.mutable_targets()->Add(graph.GetTargets().begin(), graph.GetTargets().end());
+    proto_graph.mutable_weights()->Add(graph.GetWeights().begin(), graph.GetWeights().end());
 }
 
 void proto_info::ProtoInfo::HelperAddEdgesInProto(TransportRouter& route) {
-    for (auto& [id, info] : route.GetEdges()) {
+    for (size_t id = 0; id < route.GetEdges().size(); ++id) {
+        const EdgeInfo& info = route.GetEdges()[id];
         t_catalogue_proto::EdgeInfo edge_info;
         edge_info.set_edge_id(id);
-        edge_info.set_name(std::string(info.name));
+        edge_info.set_id(info.id);
         edge_info.set_count(info.span_count);
         edge_info.set_time(info.time);
         edge_info.set_is_bus(info.type);
-        *t_catalogue_.mutable_transport_router()->mutable_edges_()->Add() = edge_info;
-    }
-}
-
-
-void proto_info::ProtoInfo::HelperAddStopnamesToIdInProto(TransportRouter& route) {
-    for (auto& [stopname_, id_] : route.GetStopnameToId()) {
-        t_catalogue_proto::StopnamesToId stopnames_to_id;
-        stopnames_to_id.set_stopname(std::string(stopname_));
-        stopnames_to_id.set_id(id_);
-        *t_catalogue_.mutable_transport_router()->mutable_stopnames_to_id_()->Add() = stopnames_to_id;
+        *transport_router_.mutable_edges_()->Add() = edge_info;
     }
 }
 
 void proto_info::ProtoInfo::HelperAddRouterInProto(TransportRouter& route) {
-    for (size_t i = 0; i < route.GetRouter()->GetRoutesInternalData().size(); ++i) {
-        t_catalogue_proto::HelpRepeated help_repeated;
-        for (size_t j = 0; j < route.GetRouter()->GetRoutesInternalData()[i].size(); ++j) {
-            t_catalogue_proto::HelpOpt help_opt;
-            if (route.GetRouter()->GetRoutesInternalData()[i][j].has_value()) {
-                help_opt.mutable_help_opt()->set_weight(route.GetRouter()->GetRoutesInternalData()[i][j].value().weight);
-                if (route.GetRouter()->GetRoutesInternalData()[i][j].value().prev_edge.has_value()) {
-                    help_opt.mutable_help_opt()->set_prev_edge(route.GetRouter()->
-                                                               GetRoutesInternalData()[i][j].value().prev_edge.value());
-                }
-            }
-            *help_repeated.mutable_help_repeated()->Add() = help_opt;
-        }
-        *t_catalogue_.mutable_transport_router()->mutable_router_()->
-         mutable_routes_internal_data()->mutable_routes()->Add() = help_repeated;
+    if (route.GetRouterType() == RouterType::CONTRACTION_HIERARCHIES) {
+        HelperAddContractionInProto(route);
+        return;
+    }
+    //Таблица маршрутов хранится только для маршрутизатора с предрасчётом всех пар вершин
+    if (route.GetRouterType() != RouterType::ALL_PAIRS) {
+        return;
     }
+    //Сама таблица пишется отдельной секцией файла в Serialization
+    routes_ = static_cast<graph::Router<double>&>(*route.GetRouter()).GetRoutes();
+    transport_router_.mutable_router_()->set_vertex_count(routes_.vertex_count);
 }
 
 void proto_info::ProtoInfo::ParseProtoGraph(TransportRouter& route) {
-    for (size_t i = 0; i < t_catalogue_.mutable_transport_router()->mutable_graph()->edges_size(); ++i) {
-        graph::Edge<double> edge;
-        edge.from = t_catalogue_.mutable_transport_router()->mutable_graph()->mutable_edges(i)->from();
-        edge.to = t_catalogue_.mutable_transport_router()->mutable_graph()->mutable_edges(i)->to();
-        edge.weight = t_catalogue_.mutable_transport_router()->mutable_graph()->mutable_edges(i)->weight();
-        route.GetGraph().GetEdges().push_back(edge);
-    }
-
-    for (size_t i = 0; i < t_catalogue_.mutable_transport_router()->mutable_graph()->incidence_lists_size(); ++i) {
-        std::vector<graph::EdgeId> incidence_list;
-        incidence_list.reserve(t_catalogue_.mutable_transport_router()->
-                               mutable_graph()->mutable_incidence_lists(i)->list_size());
-        for (size_t j = 0; j < t_catalogue_.mutable_transport_router()->
-                               mutable_graph()->mutable_incidence_lists(i)->list_size(); ++j) {
-            incidence_list.push_back(t_catalogue_.mutable_transport_router()->
-                                     mutable_graph()->mutable_incidence_lists(i)->list(j));
-        }
-        route.GetGraph().GetIncidenceLists().push_back(incidence_list);
-    }
+    const auto& proto_graph = transport_router_.graph();
+    route.GetGraph() = graph::CsrGraph<double>({proto_graph.offsets().begin(), proto_graph.offsets().end()},
+                                               {proto_graph.targets().begin(), proto_graph.targets().end()},
+                                               {proto_graph.weights().begin(), proto_graph.weights().end()});
 }
 
-void proto_info::ProtoInfo::ParseProtoEdgeInfo(TransportRouter& route, TransportCatalogue& db) {
-    for (size_t i = 0; i < t_catalogue_.mutable_transport_router()->edges__size(); ++i) {
+void proto_info::ProtoInfo::ParseProtoEdgeInfo(TransportRouter& route) {
+    route.GetEdges().resize(transport_router_.edges__size());
+    for (int i = 0; i < transport_router_.edges__size(); ++i) {
         EdgeInfo edge_info;
-        if (t_catalogue_.mutable_transport_router()->mutable_edges_(i)->is_bus()) {
-            edge_info.type = EdgeType::BUS_T;
-            edge_info.name = db.FindStop(t_catalogue_.mutable_transport_router()->mutable_edges_(i)->name())->stopname;
-        } else {
-            edge_info.type = EdgeType::WAIT;
-            edge_info.name = db.FindBus(t_catalogue_.mutable_transport_router()->mutable_edges_(i)->name())->busname;
-        }
-        edge_info.span_count = t_catalogue_.mutable_transport_router()->mutable_edges_(i)->count();
-        edge_info.time = t_catalogue_.mutable_transport_router()->mutable_edges_(i)->time();
-        route.GetEdges().insert({ t_catalogue_.mutable_transport_router()->mutable_edges_(i)->edge_id(), edge_info });
+        edge_info.type = transport_router_.mutable_edges_(i)->is_bus() ? EdgeType::BUS_T : EdgeType::WAIT;
+        edge_info.id = transport_router_.mutable_edges_(i)->id();
+        edge_info.span_count = transport_router_.mutable_edges_(i)->count();
+        edge_info.time = transport_router_.mutable_edges_(i)->time();
+        route.GetEdges().at(transport_router_.mutable_edges_(i)->edge_id()) = edge_info;
+    }
+}
+
+
+void proto_info::ProtoInfo::HelperAddContractionInProto(TransportRouter& route) {
+    const auto& router = static_cast<graph::ContractionRouter<double>&>(*route.GetRouter());
+    auto* proto_contraction = transport_router_.mutable_contraction_hierarchies();
+    for (const uint32_t rank : router.GetRanks()) {
+        proto_contraction->add_ranks(rank);
+    }
+    for (const auto& shortcut : router.GetShortcuts()) {
+        t_catalogue_proto::Shortcut proto_shortcut;
+        proto_shortcut.set_from(shortcut.from);
+        proto_shortcut.set_to(shortcut.to);
+        proto_shortcut.set_weight(shortcut.weight);
+        proto_shortcut.set_first(shortcut.first);
+        proto_shortcut.set_second(shortcut.second);
+        *proto_contraction->mutable_shortcuts()->Add() = proto_shortcut;
     }
 }
 
-void proto_info::ProtoInfo::ParseProtoStopnamesToId(TransportRouter& route) {
-    for (size_t i = 0; i < t_catalogue_.mutable_transport_router()->stopnames_to_id__size(); ++i) {
-        route.GetStopnameToId().insert({ t_catalogue_.mutable_transport_router()->mutable_stopnames_to_id_(i)->stopname(),
-                                  t_catalogue_.mutable_transport_router()->mutable_stopnames_to_id_(i)->id() });
+void proto_info::ProtoInfo::ParseProtoContraction(TransportRouter& route) {
+    const auto& proto_contraction = transport_router_.contraction_hierarchies();
+    std::vector<uint32_t> ranks(proto_contraction.ranks().begin(), proto_contraction.ranks().end());
+
+    std::vector<graph::ContractionRouter<double>::Shortcut> shortcuts;
+    shortcuts.reserve(proto_contraction.shortcuts_size());
+    for (const auto& proto_shortcut : proto_contraction.shortcuts()) {
+        shortcuts.push_back({proto_shortcut.from(), proto_shortcut.to(), proto_shortcut.weight(),
+                             proto_shortcut.first(), proto_shortcut.second()});
     }
+
+    route.GetRouter() = std::make_unique<graph::ContractionRouter<double>>(route.GetGraph(), std::move(ranks),
+                                                                           std::move(shortcuts));
 }
 
 void proto_info::ProtoInfo::ParseProtoRouter(TransportRouter& route) {
-    std::vector<std::vector<std::optional<graph::Router<double>::RouteInternalData>>> buffer;
-    buffer.reserve(t_catalogue_.mutable_transport_router()->
-                   mutable_router_()->mutable_routes_internal_data()->routes_size());
-
-    for (size_t i = 0; i < t_catalogue_.mutable_transport_router()->
-                           mutable_router_()->mutable_routes_internal_data()->routes_size(); ++i) {
-        std::vector<std::optional<graph::Router<double>::RouteInternalData>> result;
-        result.reserve(t_catalogue_.mutable_transport_router()->
-                       mutable_router_()->mutable_routes_internal_data()->mutable_routes(i)->help_repeated_size());
-
-        for (size_t j = 0; j < t_catalogue_.mutable_transport_router()->
-                               mutable_router_()->mutable_routes_internal_data()->mutable_routes(i)->help_repeated_size(); ++j) {
-            graph::Router<double>::RouteInternalData route_internal_data;
-            if (t_catalogue_.mutable_transport_router()->
-                mutable_router_()->mutable_routes_internal_data()->
-                mutable_routes(i)->mutable_help_repeated(j)->h_opt_case() == 1) {
-                route_internal_data.weight = t_catalogue_.mutable_transport_router()->
-                                             mutable_router_()->mutable_routes_internal_data()->
-                                             mutable_routes(i)->mutable_help_repeated(j)->mutable_help_opt()->weight();
-                if (t_catalogue_.mutable_transport_router()->
-                    mutable_router_()->mutable_routes_internal_data()->
-                    mutable_routes(i)->mutable_help_repeated(j)->mutable_help_opt()->TEST_case() == 2) {
-                    route_internal_data.prev_edge = std::make_optional<size_t>(t_catalogue_.mutable_transport_router()->
-                                                                               mutable_router_()->mutable_routes_internal_data()->
-                                                                               mutable_routes(i)->mutable_help_repeated(j)->mutable_help_opt()->prev_edge());
-                }
-                result.push_back(std::make_optional<graph::Router<double>::RouteInternalData>(route_internal_data));
-            }
-            else {
-                result.push_back(std::nullopt);
-            }
+    route.SetRouterType(static_cast<RouterType>(transport_router_.router_type()));
+    if (route.GetRouterType() == RouterType::CONTRACTION_HIERARCHIES) {
+        ParseProtoContraction(route);
+        return;
+    }
+    if (route.GetRouterType() != RouterType::ALL_PAIRS) {
+        route.BuildRouter();
+        return;
+    }
 
-        }
-        buffer.push_back(result);
+    const size_t vertex_count = transport_router_.router_().vertex_count();
+    const size_t cell_count = vertex_count * vertex_count;
+    const SectionEntry& routes_section = GetSection(BaseSection::ROUTES);
+    if (routes_section.offset == 0 || routes_section.size != cell_count * (sizeof(double) + sizeof(uint32_t))) {
+        throw std::runtime_error("Base file has no routes table");
     }
 
-    route.GetRouter() = std::make_unique<graph::Router<double>>(route.GetGraph(), buffer);
+    //Таблица читается прямо из отображённых страниц файла, файл живёт, пока жив маршрутизатор
+    graph::Router<double>::RoutesView routes;
+    routes.vertex_count = vertex_count;
+    routes.weights = reinterpret_cast<const double*>(base_file_->GetData() + routes_section.offset);
+    routes.prev_edges = reinterpret_cast<const uint32_t*>(base_file_->GetData() + routes_section.offset
+                                                           + cell_count * sizeof(double));
+    routes.holder = base_file_;
+
+    route.GetRouter() = std::make_unique<graph::Router<double>>(route.GetGraph(), std::move(routes));
 }
 
 std::vector<Stop> proto_info::ProtoInfo::ParseProtoStops() {
+    const t_catalogue_proto::TransportCatalogue& catalogue = GetCatalogue();
     std::vector<Stop> result_stops;
-    result_stops.reserve(t_catalogue_.stops_size());
+    result_stops.reserve(catalogue.stops_size());
 
-    for (size_t i = 0; i < t_catalogue_.stops_size(); ++i) {
+    for (int i = 0; i < catalogue.stops_size(); ++i) {
         Stop stop;
         //stop.vertex_id = t_catalogue_.mutable_stops(i)->vertex_id();
-        stop.stopname = t_catalogue_.mutable_stops(i)->stop_name();
-        stop.coordinates.lat = t_catalogue_.mutable_stops(i)->coordinates_().lat();
-        stop.coordinates.lng = static_cast<double>(t_catalogue_.mutable_stops(i)->coordinates_().lng());
+        stop.stopname = catalogue.stops(i).stop_name();
+        stop.coordinates.lat = catalogue.stops(i).coordinates_().lat();
+        stop.coordinates.lng = static_cast<double>(catalogue.stops(i).coordinates_().lng());
         result_stops.push_back(stop);
     }
     return result_stops;
 }
-
-using StopsDistances = std::unordered_map<PairStops, size_t, PairStopsHasher>;
-
-StopsDistances proto_info::ProtoInfo::ParseProtoDistance(TransportCatalogue& db) {
-    StopsDistances result_distance;
-    result_distance.reserve(t_catalogue_.stops_distance_size());
-
-    for (size_t i = 0; i < t_catalogue_.stops_distance_size(); ++i) {
-        PairStops stops;
-        stops.first = db.FindStop(t_catalogue_.mutable_stops_distance(i)->stop_one());
-        stops.second = db.FindStop(t_catalogue_.mutable_stops_distance(i)->stop_two());
-        result_distance[stops] = t_catalogue_.mutable_stops_distance(i)->distance();
-    }
-
-    return result_distance;
-}
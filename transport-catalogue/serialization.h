@@ -4,9 +4,17 @@
 #include "map_renderer.h"
 #include "transport_router.h"
 #include "graph.h"
+#include "contraction_router.h"
+#include "mapped_file.h"
 
+#include <array>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
 
 #include <transport_catalogue.pb.h>
 #include <map_renderer.pb.h>
@@ -16,29 +24,87 @@
 
 
 namespace proto_info {
+
+//Секции файла базы. Каждая читается независимо: ответ на запросы одного типа не требует
+//разбора остальных
+enum class BaseSection : uint32_t {
+    CATALOGUE,          //остановки и маршруты
+    BUS_STATS,          //статистика маршрутов
+    RENDER_SETTINGS,    //настройки отрисовки карты
+    ROUTER,             //граф и маршрутизатор
+    SVG,                //готовая карта в формате SVG
+    ROUTES,             //таблица маршрутов между всеми парами вершин
+    COUNT
+};
+
+//Положение секции в файле; у отсутствующей секции размер 0
+struct SectionEntry {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+};
+
 class ProtoInfo {
 public:
     ProtoInfo() = default;
-    ProtoInfo(TransportCatalogue& db,
-              renderer::MapRenderer& renderer, TransportRouter& route);
+    //Незавершённая запись базы отменяется: временный файл удаляется
+    ~ProtoInfo();
 
-    void Serialization(const std::filesystem::path& path);
+    //Файл базы: заголовок с оглавлением и секции BaseSection. Секции protobuf разбираются только
+    //при вызове соответствующего Parse*, выровненная по странице таблица маршрутов и карта
+    //не разбираются, а читаются из отображённого в память файла
     void Deserialization(const std::filesystem::path& path);
 
-    std::vector<Stop> ParseProtoStops();
+    //Потоковая запись базы: каждая секция дописывается в файл, как только готова, в любом порядке.
+    //Write* для разных секций можно вызывать из разных потоков; оглавление записывается в заголовок
+    //в EndSerialization. База пишется во временный файл рядом с path и заменяет path только
+    //целиком: процессы, которые отобразили старый файл в память, продолжают читать его
+    void BeginSerialization(const std::filesystem::path& path);
+    void WriteCatalogue(TransportCatalogue& db);
+    void WriteBusStats(TransportCatalogue& db);
+    void WriteMap(renderer::MapRenderer& renderer);
+    void WriteRouter(TransportRouter& route);
+    void EndSerialization();
 
-    using StopsDistances = std::unordered_map<PairStops, size_t, PairStopsHasher>;
+    std::vector<Stop> ParseProtoStops();
 
-    StopsDistances ParseProtoDistance(TransportCatalogue& db);
     std::vector<Bus> ParseProtoBuses(TransportCatalogue& db);
+    std::vector<BusInfo> ParseProtoBusInfos();
     void ParseProtoMap(renderer::MapRenderer& renderer);
-    void ParseProtoTransportRouter(TransportRouter& route, TransportCatalogue& db);
+    std::string ParseProtoSvg();
+    //В базе есть готовая карта
+    bool HasSvg() const;
+    void ParseProtoTransportRouter(TransportRouter& route);
 
 private:
     t_catalogue_proto::TransportCatalogue t_catalogue_;
+    t_catalogue_proto::BusStatsList bus_stats_;
+    t_catalogue_proto::Map map_;
+    t_catalogue_proto::TransportRouter transport_router_;
+    //Таблица маршрутов, записываемая отдельной секцией файла
+    graph::Router<double>::RoutesView routes_;
+    //Прочитанный файл базы и оглавление его секций
+    std::shared_ptr<const MappedFile> base_file_;
+    std::array<SectionEntry, static_cast<size_t>(BaseSection::COUNT)> sections_{};
+    bool is_catalogue_parsed_ = false;
+    //Записываемый файл базы, временный файл, в который он пишется, и смещение его конца;
+    //секции дописываются под write_mutex_
+    std::filesystem::path out_path_;
+    std::filesystem::path temp_path_;
+    std::ofstream out_file_;
+    uint64_t write_offset_ = 0;
+    std::mutex write_mutex_;
+
+    //Сообщение кодируется без блокировки и сразу освобождается: в памяти не копятся все секции
+    template <typename Message>
+    void WriteSection(BaseSection section, Message& message);
+    void WriteSection(BaseSection section, std::string_view data);
+
+    const SectionEntry& GetSection(BaseSection section) const;
+    void ParseSection(BaseSection section, google::protobuf::MessageLite& message);
+    const t_catalogue_proto::TransportCatalogue& GetCatalogue();
 
     void AddBuses(TransportCatalogue& db);
-    void AddDistance(TransportCatalogue& db);
+    void AddBusStats(TransportCatalogue& db);
     void AddStops(TransportCatalogue& db);
     void AddMap(renderer::MapRenderer& renderer);
     void AddRoute(TransportRouter& route);
@@ -48,11 +114,18 @@ private:
     void AddColorPaletteOutProto(renderer::MapRenderer& renderer);
     void HelperAddGraphInProto(TransportRouter& route);
     void HelperAddEdgesInProto(TransportRouter& route);
-    void HelperAddStopnamesToIdInProto(TransportRouter& route);
     void HelperAddRouterInProto(TransportRouter& route);
+    void HelperAddContractionInProto(TransportRouter& route);
     void ParseProtoGraph(TransportRouter& route);
-    void ParseProtoEdgeInfo(TransportRouter& route, TransportCatalogue& db);
-    void ParseProtoStopnamesToId(TransportRouter& route);
+    void ParseProtoEdgeInfo(TransportRouter& route);
     void ParseProtoRouter(TransportRouter& route);
+    void ParseProtoContraction(TransportRouter& route);
 };
+
+template <typename Message>
+void ProtoInfo::WriteSection(BaseSection section, Message& message) {
+    const std::string data = message.SerializeAsString();
+    message = Message();
+    WriteSection(section, std::string_view(data));
+}
 }
@@ -1,5 +1,8 @@
 #include "svg.h"
 #include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <sstream>
 #include <string>
 #include <string_view>
 
@@ -13,7 +16,7 @@ void Object::Render(const RenderContext& context) const {
     // Делегируем вывод тега своим подклассам
     RenderObject(context);
 
-    context.out << std::endl;
+    context.out.put('\n');
 }
 
 // ---------- Circle ------------------
@@ -117,20 +120,159 @@ void Text::RenderObject(const RenderContext& context) const {
     out << ">" << data_ << "</text>";
 }
 
+// ---------- PathStyle ------------------
+
+std::string PathStyle::RenderAttrs() const {
+    std::ostringstream out;
+    PathProps::RenderAttrs(out);
+    return out.str();
+}
+
+// ---------- Writer ------------------
+
+Writer::Writer(std::string& output)
+    : output_(output) {
+}
+
+void Writer::StartDocument() {
+    output_ += "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n\n"sv;
+    output_ += "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\n"sv;
+}
+
+void Writer::StartDocument(Point view_min, Point view_size) {
+    output_ += "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n\n"sv;
+    output_ += "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\" viewBox=\""sv;
+    WriteNumber(view_min.x);
+    output_ += ' ';
+    WriteNumber(view_min.y);
+    output_ += ' ';
+    WriteNumber(view_size.x);
+    output_ += ' ';
+    WriteNumber(view_size.y);
+    output_ += "\">\n"sv;
+}
+
+void Writer::EndDocument() {
+    output_ += "</svg>\n"sv;
+}
+
+// Шесть значащих цифр в общем формате, как при выводе double в std::ostream
+void Writer::WriteNumber(double value) {
+    char buffer[32];
+    const auto result = std::to_chars(std::begin(buffer), std::end(buffer), value, std::chars_format::general, 6);
+    output_.append(buffer, result.ptr);
+}
+
+void Writer::WriteNumber(uint32_t value) {
+    char buffer[16];
+    const auto result = std::to_chars(std::begin(buffer), std::end(buffer), value);
+    output_.append(buffer, result.ptr);
+}
+
+void Writer::StartElement() {
+    output_ += "  "sv;
+}
+
+void Writer::AddCircle(Point center, double radius, std::string_view attrs) {
+    StartElement();
+    output_ += "<circle cx=\""sv;
+    WriteNumber(center.x);
+    output_ += "\" cy=\""sv;
+    WriteNumber(center.y);
+    output_ += "\" r=\""sv;
+    WriteNumber(radius);
+    output_ += "\" "sv;
+    output_ += attrs;
+    output_ += "/>\n"sv;
+}
+
+void Writer::StartPolyline() {
+    StartElement();
+    output_ += "<polyline points=\""sv;
+    has_points_ = false;
+}
+
+void Writer::AddPolylinePoint(Point point) {
+    if (has_points_) {
+        output_ += ' ';
+    }
+    WriteNumber(point.x);
+    output_ += ',';
+    WriteNumber(point.y);
+    has_points_ = true;
+}
+
+void Writer::EndPolyline(std::string_view attrs) {
+    output_ += '"';
+    output_ += attrs;
+    output_ += "/>\n"sv;
+}
+
+void Writer::AddText(Point position, Point offset, uint32_t font_size, std::string_view font_family,
+                     std::string_view font_weight, std::string_view data, std::string_view attrs) {
+    StartElement();
+    output_ += "<text"sv;
+    output_ += attrs;
+    output_ += " x=\""sv;
+    WriteNumber(position.x);
+    output_ += "\" y=\""sv;
+    WriteNumber(position.y);
+    output_ += "\" dx=\""sv;
+    WriteNumber(offset.x);
+    output_ += "\" dy=\""sv;
+    WriteNumber(offset.y);
+    output_ += "\" font-size=\""sv;
+    WriteNumber(font_size);
+    output_ += '"';
+    if (!font_family.empty()) {
+        output_ += " font-family=\""sv;
+        output_ += font_family;
+        output_ += '"';
+    }
+    if (!font_weight.empty()) {
+        output_ += " font-weight=\""sv;
+        output_ += font_weight;
+        output_ += '"';
+    }
+    output_ += '>';
+    for (const char c : data) {
+        switch (c) {
+        case '"':
+            output_ += "&quot;"sv;
+            break;
+        case '<':
+            output_ += "&lt;"sv;
+            break;
+        case '>':
+            output_ += "&gt;"sv;
+            break;
+        case '\'':
+            output_ += "&apos;"sv;
+            break;
+        case '&':
+            output_ += "&amp;"sv;
+            break;
+        default:
+            output_ += c;
+        }
+    }
+    output_ += "</text>\n"sv;
+}
+
 void Document::AddPtr(std::unique_ptr<Object>&& obj) {
     objects_.emplace_back(std::move(obj));
 }
 
 // Выводит в ostream svg-представление документа
 void Document::Render(std::ostream& out) const {
-    out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"sv << std::endl;
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n\n"sv;
     out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\n"sv;
 
     RenderContext contex(out, 2, 2);
     for (auto& obj : objects_) {
         obj->Render(contex);
     }
-    out << "</svg>"sv << std::endl; //check endl
+    out << "</svg>\n"sv;
 }
 
 void OstreamColorPrinter::operator()(std::monostate) const {
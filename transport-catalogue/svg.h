@@ -11,6 +11,7 @@
 #include <variant>
 #include <cstdint>
 #include <optional>
+#include <string_view>
 
 namespace svg {
 
@@ -232,6 +233,16 @@ private:
 };
 
 
+/*
+ * Класс PathStyle хранит оформление фигуры без самой фигуры. Атрибуты записываются в строку
+ * один раз и подставляются Writer во все элементы с таким оформлением
+ */
+class PathStyle final : public PathProps<PathStyle> {
+public:
+    // Атрибуты оформления в том виде, в каком их выводят Circle, Polyline и Text
+    std::string RenderAttrs() const;
+};
+
 /*
  * Класс Circle моделирует элемент <circle> для отображения круга
  * https://developer.mozilla.org/en-US/docs/Web/SVG/Element/circle
@@ -333,6 +344,44 @@ private:
 };
 
 
+/*
+ * Класс Writer записывает SVG-документ прямо в строку, без промежуточных объектов Object:
+ * элементы выводятся сразу, числа форматируются std::to_chars. Текст совпадает с выводом
+ * Document::Render. Оформление передаётся атрибутами, заранее записанными PathStyle::RenderAttrs
+ */
+class Writer {
+public:
+    explicit Writer(std::string& output);
+
+    // Заголовок и открывающий тег <svg>
+    void StartDocument();
+    // Открывающий тег с атрибутом viewBox: видна только область размера view_size от view_min
+    void StartDocument(Point view_min, Point view_size);
+    // Закрывающий тег </svg>
+    void EndDocument();
+
+    void AddCircle(Point center, double radius, std::string_view attrs);
+
+    // Вершины ломаной передаются между StartPolyline и EndPolyline
+    void StartPolyline();
+    void AddPolylinePoint(Point point);
+    void EndPolyline(std::string_view attrs);
+
+    // Пустые font_family и font_weight не выводятся. Спецсимволы XML в data экранируются
+    void AddText(Point position, Point offset, uint32_t font_size, std::string_view font_family,
+                 std::string_view font_weight, std::string_view data, std::string_view attrs);
+
+private:
+    std::string& output_;
+    // В ломаную уже записана хотя бы одна вершина
+    bool has_points_ = false;
+
+    void WriteNumber(double value);
+    void WriteNumber(uint32_t value);
+    // Отступ элемента внутри <svg>
+    void StartElement();
+};
+
 class Drawable {
 public:
     virtual void Draw(ObjectContainer& container) const = 0;
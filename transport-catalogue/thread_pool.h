@@ -0,0 +1,71 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Пул потоков фиксированного размера с общей очередью задач
+class ThreadPool {
+public:
+    // Нулевое число потоков означает число аппаратных потоков
+    explicit ThreadPool(size_t thread_count = 0);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Дожидается выполнения всех поставленных задач и останавливает потоки
+    ~ThreadPool();
+
+    size_t GetThreadCount() const;
+
+    // Ставит задачу в очередь, результат (или исключение) доступен через future
+    template <typename Task>
+    auto Submit(Task task) -> std::future<decltype(task())>;
+
+    // Выполняет func(i) для всех i из [0, count) и дожидается завершения.
+    // Первое возникшее исключение пробрасывается вызывающему
+    template <typename Func>
+    void ParallelFor(size_t count, Func func);
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable has_task_;
+    bool is_stopped_ = false;
+
+    void WorkerLoop();
+};
+
+template <typename Task>
+auto ThreadPool::Submit(Task task) -> std::future<decltype(task())> {
+    using Result = decltype(task());
+    auto packaged_task = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+    std::future<Result> result = packaged_task->get_future();
+    {
+        std::lock_guard lock(mutex_);
+        tasks_.emplace([packaged_task] { (*packaged_task)(); });
+    }
+    has_task_.notify_one();
+    return result;
+}
+
+template <typename Func>
+void ThreadPool::ParallelFor(size_t count, Func func) {
+    std::vector<std::future<void>> results;
+    results.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        results.push_back(Submit([&func, i] { func(i); }));
+    }
+    for (auto& result : results) {
+        result.wait();
+    }
+    for (auto& result : results) {
+        result.get();
+    }
+}
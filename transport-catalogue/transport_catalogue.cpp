@@ -9,14 +9,13 @@
 #include <deque>
 #include <iostream>
 #include <iomanip>
+#include <stdexcept>
+#include <tuple>
 
 
 
 void TransportCatalogue::AddStop(const Stop& stop, DistancesToStops& distance_to_stops) {
-    stops_.push_back(stop);
-
-    stopname_to_stop_[stops_.back().stopname] = &stops_.back();
-    stopname_to_buses_[stops_.back().stopname];
+    AddStop(stop);
 
     StopsWithDistances stops_with_distance;
 
@@ -28,9 +27,10 @@ void TransportCatalogue::AddStop(const Stop& stop, DistancesToStops& distance_to
 
 void TransportCatalogue::AddStop(const Stop& stop) {
     stops_.push_back(stop);
+    stops_.back().id = static_cast<uint32_t>(stops_.size() - 1);
 
     stopname_to_stop_[stops_.back().stopname] = &stops_.back();
-    stopname_to_buses_[stops_.back().stopname];
+    stop_id_to_buses_.emplace_back();
 }
 
 const Stop* TransportCatalogue::FindStop(std::string_view stopname) const {
@@ -44,17 +44,28 @@ const Stop* TransportCatalogue::FindStop(std::string_view stopname) const {
 }
 
 
+//Остановки маршрута ищутся до его добавления: неизвестная остановка не должна попасть в каталог
+//под номером пустой остановки
 void TransportCatalogue::AddBus(std::string_view busname, std::vector<std::string>& stopnames, bool is_roundtrip) {
+    std::vector<const Stop*> stops;
+    stops.reserve(stopnames.size());
+    for (const auto& stopname : stopnames) {
+        const auto found_stop = stopname_to_stop_.find(stopname);
+        if (found_stop == stopname_to_stop_.end()) {
+            throw std::invalid_argument("Unknown stop " + stopname + " in bus " + std::string(busname));
+        }
+        stops.push_back(found_stop->second);
+    }
+
     buses_.push_back(Bus{});
     auto bus = &buses_.back();
     bus->busname = busname;
     bus->is_roundtrip = is_roundtrip;
+    bus->id = static_cast<uint32_t>(buses_.size() - 1);
+    bus->stops = std::move(stops);
 
-    for(const auto& stopname : stopnames) {
-        const Stop* found_stop = FindStop(stopname);
-        bus->stops.push_back(found_stop);
-
-        stopname_to_buses_[found_stop->stopname].insert(bus->busname);
+    for (const Stop* stop : bus->stops) {
+        stop_id_to_buses_[stop->id].insert(bus->busname);
     }
 
     busname_to_bus_[buses_.back().busname] = bus;
@@ -63,20 +74,52 @@ void TransportCatalogue::AddBus(std::string_view busname, std::vector<std::strin
 void TransportCatalogue::AddBus(Bus add_bus) {
     buses_.push_back(add_bus);
     auto bus = &buses_.back();
+    bus->id = static_cast<uint32_t>(buses_.size() - 1);
 
     for(const auto& stop : bus->stops) {
-        stopname_to_buses_[stop->stopname].insert(bus->busname);
+        stop_id_to_buses_[stop->id].insert(bus->busname);
     }
     busname_to_bus_[buses_.back().busname] = bus;
 }
 
 void TransportCatalogue::DistanceAdd() {
-   for (const auto& stop_distances : stops_with_distance_) {
-       if (stop_distances.distances.empty()) {
-           continue;
-       }
-       StopsDistancesAdd(stop_distances.stop, stop_distances.distances);
-   }
+    //Каждое заданное расстояние записывается и в обратную сторону с пометкой is_reverse:
+    //после сортировки явно заданное расстояние идёт раньше обратного для той же пары
+    struct DistanceEntry {
+        uint32_t from;
+        uint32_t to;
+        bool is_reverse;
+        uint32_t distance;
+    };
+    std::vector<DistanceEntry> entries;
+    for (const auto& stop_distances : stops_with_distance_) {
+        for (const auto& [stopname, distance] : stop_distances.distances) {
+            const Stop* stop_to = FindStop(stopname);
+            if (stop_to->stopname != stopname) {
+                continue;
+            }
+            entries.push_back({stop_distances.stop->id, stop_to->id, false, static_cast<uint32_t>(distance)});
+            entries.push_back({stop_to->id, stop_distances.stop->id, true, static_cast<uint32_t>(distance)});
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [](const DistanceEntry& lhs, const DistanceEntry& rhs) {
+        return std::tie(lhs.from, lhs.to, lhs.is_reverse) < std::tie(rhs.from, rhs.to, rhs.is_reverse);
+    });
+
+    RoadDistances road_distances;
+    road_distances.offsets.assign(stops_.size() + 1, 0);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (i > 0 && entries[i].from == entries[i - 1].from && entries[i].to == entries[i - 1].to) {
+            continue;
+        }
+        road_distances.neighbors.push_back(entries[i].to);
+        road_distances.distances.push_back(entries[i].distance);
+        ++road_distances.offsets[entries[i].from + 1];
+    }
+    for (size_t stop_id = 0; stop_id < stops_.size(); ++stop_id) {
+        road_distances.offsets[stop_id + 1] += road_distances.offsets[stop_id];
+    }
+    road_distances_ = std::move(road_distances);
 }
 
 const std::deque<Stop>& TransportCatalogue::GetStops() const {
@@ -91,19 +134,6 @@ const std::deque<Bus>& TransportCatalogue::GetBuses() const {
     return buses_;
 }
 
-void TransportCatalogue::SetDistancesToStops(std::unordered_map<PairStops, size_t, PairStopsHasher> distances_to_stops) {
-    distances_to_stops_ = distances_to_stops;
-}
-
-
-
-void TransportCatalogue::StopsDistancesAdd(const Stop* stop, const DistancesToStops&  distances) {
-
-    for (const auto& [stopname, distance] : distances) {
-        SetDistancesToStops(stop, FindStop(stopname), distance);
-    }
-}
-
 const Bus* TransportCatalogue::FindBus(std::string_view busname) const {
 
     const auto finded_bus = busname_to_bus_.find(busname);
@@ -122,35 +152,49 @@ const BusInfo TransportCatalogue::GetBusInfo(std::string_view busname) const {
         bus_info.is_found = false;
         return bus_info;
     }
+    if (bus->id < bus_infos_.size()) {
+        return bus_infos_[bus->id];
+    }
+    return ComputeBusInfo(*bus);
+}
+
+const std::vector<BusInfo>& TransportCatalogue::GetBusInfos() const {
+    return bus_infos_;
+}
+
+void TransportCatalogue::SetBusInfos(std::vector<BusInfo> bus_infos) {
+    if (bus_infos.size() != buses_.size()) {
+        throw std::invalid_argument("Bus infos don't match the buses");
+    }
+    bus_infos_ = std::move(bus_infos);
+}
 
-    std::unordered_set<const Stop*> uniq_stops = {*bus->stops.begin()};
+BusInfo TransportCatalogue::ComputeBusInfo(const Bus& bus) const {
+    std::vector<uint32_t> uniq_stops;
+    uniq_stops.reserve(bus.stops.size());
     size_t route_len = 0;
     double straight_way = 0.0;
 
-    geo::Coordinates coordinate_from = (*bus->stops.begin())->coordinates;
-    geo::Coordinates coordinate_to;
-    const Stop* stop_from = *bus->stops.begin();
-    const Stop* stop_to;
+    uniq_stops.push_back((*bus.stops.begin())->id);
+    const Stop* stop_from = *bus.stops.begin();
 
     //Проход по каждой остановки начиная со второй, вычисление растояние и
     //добавление в уникальные остановки
-    for (auto iter = std::next(bus->stops.begin()); iter != bus->stops.end(); ++iter) {
-        coordinate_to = (*iter)->coordinates;
-        straight_way += geo::ComputeDistance(coordinate_from, coordinate_to);
-        coordinate_from = coordinate_to;
-
-        stop_to = *iter;
-        route_len += distances_to_stops_.at(PairStops{stop_from, stop_to});
+    for (auto iter = std::next(bus.stops.begin()); iter != bus.stops.end(); ++iter) {
+        const Stop* stop_to = *iter;
+        straight_way += geo::ComputeDistance(stop_from->coordinates, stop_to->coordinates);
+        route_len += GetDistance(stop_from->id, stop_to->id);
         stop_from = stop_to;
 
-        uniq_stops.insert(*iter);
+        uniq_stops.push_back(stop_to->id);
     }
+    std::sort(uniq_stops.begin(), uniq_stops.end());
 
     BusInfo bus_info;
 
-    bus_info.busname = std::string(busname);
-    bus_info.stops_count = bus->stops.size();
-    bus_info.uniq_stops_count = uniq_stops.size();
+    bus_info.busname = bus.busname;
+    bus_info.stops_count = bus.stops.size();
+    bus_info.uniq_stops_count = std::unique(uniq_stops.begin(), uniq_stops.end()) - uniq_stops.begin();
     bus_info.route_len = route_len;
     bus_info.curvature = route_len / straight_way;
 
@@ -158,30 +202,27 @@ const BusInfo TransportCatalogue::GetBusInfo(std::string_view busname) const {
 }
 
 const StopInfo TransportCatalogue::GetStopInfo(std::string_view stopname) const {
-    auto found_stop = stopname_to_buses_.find(stopname);
+    auto found_stop = stopname_to_stop_.find(stopname);
     StopInfo stop_info;
     stop_info.stopname = stopname;
-    if (found_stop == stopname_to_buses_.end()) {
+    if (found_stop == stopname_to_stop_.end()) {
         stop_info.is_found = false;
         return stop_info;
     }
 
-    stop_info.buses = found_stop->second;
+    stop_info.buses = stop_id_to_buses_[found_stop->second->id];
 
     return stop_info;
 }
 
-void TransportCatalogue::SetDistancesToStops(const Stop* stop_from, const Stop* stop_to, size_t distance) {
-    distances_to_stops_[{stop_from, stop_to}] = distance;
-
-    PairStops reverse_pair(stop_to, stop_from);
-    if (distances_to_stops_.find(reverse_pair) == distances_to_stops_.end()) {
-        distances_to_stops_[std::move(reverse_pair)] = distance;
+size_t TransportCatalogue::GetDistance(uint32_t stop_from_id, uint32_t stop_to_id) const {
+    const auto neighbors_begin = road_distances_.neighbors.begin() + road_distances_.offsets.at(stop_from_id);
+    const auto neighbors_end = road_distances_.neighbors.begin() + road_distances_.offsets.at(stop_from_id + 1);
+    const auto neighbor = std::lower_bound(neighbors_begin, neighbors_end, stop_to_id);
+    if (neighbor == neighbors_end || *neighbor != stop_to_id) {
+        throw std::out_of_range("No road distance between stops");
     }
-}
-
-const std::unordered_map<PairStops, size_t, PairStopsHasher>& TransportCatalogue::GetDistancesToStops() const{
-    return distances_to_stops_;
+    return road_distances_.distances[neighbor - road_distances_.neighbors.begin()];
 }
 
 
@@ -26,15 +26,23 @@ public:
 
     const BusInfo GetBusInfo(std::string_view busname) const;
 
-    const StopInfo GetStopInfo(std::string_view stopname) const;
+    //Расчёт статистики маршрута после добавления всех маршрутов и расстояний. Каталог только
+    //читается, поэтому статистику разных маршрутов можно считать в разных потоках
+    BusInfo ComputeBusInfo(const Bus& bus) const;
+
+    //Статистика маршрутов по номеру маршрута. После SetBusInfos GetBusInfo не считает
+    //статистику, а берёт готовую
+    const std::vector<BusInfo>& GetBusInfos() const;
+    void SetBusInfos(std::vector<BusInfo> bus_infos);
 
-    void SetDistancesToStops(const Stop* stop_from, const Stop* stop_to, size_t distance);
+    const StopInfo GetStopInfo(std::string_view stopname) const;
 
-    const std::unordered_map<PairStops, size_t, PairStopsHasher>& GetDistancesToStops() const;
+    //Расстояние по дорогам между остановками с номерами stop_from_id и stop_to_id
+    size_t GetDistance(uint32_t stop_from_id, uint32_t stop_to_id) const;
 
     const std::unordered_map<std::string_view, const Bus*>* GetBusnameToBus() const;
 
-    //Обработка запросов на добавление дистанции между остоновками
+    //Обработка запросов на добавление дистанции между остоновками, вызывается после добавления всех остановок
     void DistanceAdd();
 
     const std::deque<Stop>& GetStops() const;
@@ -42,20 +50,16 @@ public:
 
     const std::deque<Bus>& GetBuses() const;
 
-    void SetDistancesToStops(std::unordered_map<PairStops, size_t, PairStopsHasher> distances_to_stops);
-
 private:
     std::deque<Stop> stops_;    //остановки
     std::unordered_map<std::string_view, const Stop*> stopname_to_stop_;  //индексы остановок
     std::deque<Bus> buses_; //маршруты
     std::unordered_map<std::string_view, const Bus*> busname_to_bus_;   //индексы маршрутов
-    std::unordered_map<std::string_view, std::set<std::string_view>> stopname_to_buses_ ;   //индексы остановок для маршрутов
-    std::unordered_map<PairStops, size_t, PairStopsHasher> distances_to_stops_;   //пары индексов остановок для расстояний между ними
+    std::vector<std::set<std::string_view>> stop_id_to_buses_;   //маршруты через остановку, по номеру остановки
+    RoadDistances road_distances_;   //расстояния между остановками по номерам остановок
+    std::vector<BusInfo> bus_infos_;    //статистика маршрутов по номерам маршрутов
     std::vector<StopsWithDistances> stops_with_distance_; //остановки с расстояниями до других остановок
 
-    //Добавление дистанции между остановками
-    void StopsDistancesAdd(const Stop* stop, const DistancesToStops& distances);
-
     //Сортированный список остановок
     std::vector<const Stop*> SortStops() const;
 
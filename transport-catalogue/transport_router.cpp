@@ -1,39 +1,84 @@
 #include "transport_router.h"
 #include "graph.h"
 #include "router.h"
+#include "dijkstra_router.h"
+#include "contraction_router.h"
 #include "domain.h"
 
 #include <memory>
+#include <stdexcept>
 
 
-TransportRouter::TransportRouter(size_t bus_wait_time, size_t bus_velocity, TransportCatalogue& db)
+TransportRouter::TransportRouter(size_t bus_wait_time, size_t bus_velocity, TransportCatalogue& db,
+                                 RouterType router_type, GraphModel graph_model, ThreadPool* thread_pool)
     : bus_wait_time_(bus_wait_time)
     , bus_velocity_((bus_velocity * 1000.0) / 60)
+    , router_type_(router_type)
+    , graph_model_(graph_model)
     , db_(db)
-    , graph_(db_.CountStops() * 2)
+    , graph_builder_(CountVertices())
 {
-    AddWaitEdges();
+    if (graph_model_ == GraphModel::STOP_PAIRS) {
+        AddWaitEdges();
+    }
     AddBusesEdges();
-    router_ = std::make_unique<graph::Router<double>>((graph_));
+    FreezeGraph();
+    BuildRouter(thread_pool);
+}
+
+void TransportRouter::BuildRouter(ThreadPool* thread_pool) {
+    switch (router_type_) {
+    case RouterType::ALL_PAIRS:
+        router_ = std::make_unique<graph::Router<double>>(graph_, thread_pool);
+        break;
+    case RouterType::DIJKSTRA:
+        router_ = std::make_unique<graph::DijkstraRouter<double>>(graph_);
+        break;
+    case RouterType::CONTRACTION_HIERARCHIES:
+        router_ = std::make_unique<graph::ContractionRouter<double>>(graph_);
+        break;
+    default:
+        throw std::runtime_error("Unknown router type");
+    }
 }
 
 std::optional<RouteInfo> TransportRouter::SearchRoute(std::string_view from, std::string_view to) const {
-    auto route = router_->BuildRoute((stopname_to_id_.at(from) * 2), (stopname_to_id_.at(to) * 2));
+    return SearchRoute(GetStopId(from), GetStopId(to));
+}
+
+std::optional<RouteInfo> TransportRouter::SearchRoute(uint32_t from_id, uint32_t to_id) const {
+    auto route = router_->BuildRoute(GetStopVertex(from_id), GetStopVertex(to_id));
     RouteInfo route_info;
     if (route == std::nullopt) {
         return std::nullopt;
     }
     for(const graph::EdgeId edge_id : route->edges) {
-        route_info.edge_info.emplace_back(edge_id_to_info_.at(edge_id));
+        const EdgeInfo& edge_info = edge_id_to_info_.at(edge_id);
+        //Идущие подряд рёбра автобуса (перегоны и выход в модели с цепочками) — одна поездка
+        if (edge_info.type == EdgeType::BUS_T && !route_info.edge_info.empty()
+            && route_info.edge_info.back().type == EdgeType::BUS_T) {
+            route_info.edge_info.back().span_count += edge_info.span_count;
+            route_info.edge_info.back().time += edge_info.time;
+        }
+        else {
+            route_info.edge_info.push_back(edge_info);
+        }
     }
     route_info.time = route->weight;
     return route_info;
 }
 
+uint32_t TransportRouter::GetStopId(std::string_view stopname) const {
+    const Stop* stop = db_.FindStop(stopname);
+    if (stop->stopname != stopname) {
+        throw std::out_of_range("Unknown stop");
+    }
+    return stop->id;
+}
 
-EdgeInfo TransportRouter::BuildEdgeInfo(std::string_view name, double time, EdgeType type, size_t span_count) {
+EdgeInfo TransportRouter::BuildEdgeInfo(uint32_t id, double time, EdgeType type, size_t span_count) {
     EdgeInfo edge_info;
-    edge_info.name = name;
+    edge_info.id = id;
     edge_info.time = time;
     edge_info.type = type;
     edge_info.span_count = span_count;
@@ -41,38 +86,87 @@ EdgeInfo TransportRouter::BuildEdgeInfo(std::string_view name, double time, Edge
     return edge_info;
 }
 
+//Число вершин графа: две на остановку либо одна на остановку и по одной на каждую остановку каждой цепочки
+size_t TransportRouter::CountVertices() const {
+    if (graph_model_ == GraphModel::STOP_PAIRS) {
+        return db_.CountStops() * 2;
+    }
+    size_t vertex_count = db_.CountStops();
+    for(const Bus& bus : db_.GetBuses()) {
+        vertex_count += bus.is_roundtrip ? bus.stops.size() : (bus.stops.size() / 2 + 1) * 2;
+    }
+    return vertex_count;
+}
+
+//Вершина, в которой маршрут начинается и заканчивается на остановке
+graph::VertexId TransportRouter::GetStopVertex(size_t stop_id) const {
+    return graph_model_ == GraphModel::STOP_PAIRS ? stop_id * 2 : stop_id;
+}
+
+void TransportRouter::AddEdge(const graph::Edge<double>& edge, const EdgeInfo& edge_info) {
+    graph_builder_.AddEdge(edge);
+    edge_id_to_info_.push_back(edge_info);
+}
+
+//Перенос построенного графа в CSR. Рёбра получают новые номера, описания рёбер переставляются вслед за ними
+void TransportRouter::FreezeGraph() {
+    std::vector<EdgeInfo> edge_id_to_info;
+    edge_id_to_info.reserve(edge_id_to_info_.size());
+    for (graph::VertexId vertex = 0; vertex < graph_builder_.GetVertexCount(); ++vertex) {
+        for (const graph::EdgeId edge_id : graph_builder_.GetIncidentEdges(vertex)) {
+            edge_id_to_info.push_back(edge_id_to_info_[edge_id]);
+        }
+    }
+    edge_id_to_info_ = std::move(edge_id_to_info);
+    graph_ = graph::CsrGraph<double>(graph_builder_);
+    graph_builder_ = {};
+}
+
 void TransportRouter::AddWaitEdges() {
-    size_t stop_num = 0;
     for(const Stop& stop : db_.GetStops()) {
         graph::Edge<double> edge;
 
-        edge.from = stop_num * 2;
-        edge.to = stop_num * 2 + 1;
+        edge.from = stop.id * 2;
+        edge.to = stop.id * 2 + 1;
         edge.weight = bus_wait_time_;
 
-        edge_id_to_info_[graph_.AddEdge(edge)] = BuildEdgeInfo(stop.stopname, bus_wait_time_, EdgeType::WAIT);
-        stopname_to_id_[stop.stopname] = stop_num++;
+        AddEdge(edge, BuildEdgeInfo(stop.id, bus_wait_time_, EdgeType::WAIT));
     }
 }
 
 
 
 void TransportRouter::AddBusesEdges() {
+    graph::VertexId ride_vertex = db_.CountStops();
     for(const Bus& bus : db_.GetBuses()) {
-        AddEdgesForBus(bus);
+        if (graph_model_ == GraphModel::STOP_PAIRS) {
+            AddEdgesForBus(bus);
+        }
+        else {
+            ride_vertex = AddRideChainsForBus(bus, ride_vertex);
+        }
     }
 }
 
 void TransportRouter::AddEdgesForBus(const Bus& bus) {
     if (bus.is_roundtrip == true) {
-        AddEdges(bus.stops.begin(), bus.stops.end(), bus.busname);
+        AddEdges(bus.stops.begin(), bus.stops.end(), bus.id);
     }
     else {
-        AddEdges(bus.stops.begin(), bus.stops.begin() + (bus.stops.size()/2 + 1), bus.busname);
-        AddEdges(bus.stops.begin() + (bus.stops.size()/2), bus.stops.end(), bus.busname);
+        AddEdges(bus.stops.begin(), bus.stops.begin() + (bus.stops.size()/2 + 1), bus.id);
+        AddEdges(bus.stops.begin() + (bus.stops.size()/2), bus.stops.end(), bus.id);
     }
 }
 
+//Некольцевой маршрут — две независимые цепочки: туда и обратно
+graph::VertexId TransportRouter::AddRideChainsForBus(const Bus& bus, graph::VertexId ride_vertex) {
+    if (bus.is_roundtrip == true) {
+        return AddRideChain(bus.stops.begin(), bus.stops.end(), bus.id, ride_vertex);
+    }
+    ride_vertex = AddRideChain(bus.stops.begin(), bus.stops.begin() + (bus.stops.size()/2 + 1), bus.id, ride_vertex);
+    return AddRideChain(bus.stops.begin() + (bus.stops.size()/2), bus.stops.end(), bus.id, ride_vertex);
+}
+
 //Проход по каждой остановки начиная со второй, вычисление растояние
 double TransportRouter::ComputeStopsDistance(const Stop& stop_from, const Stop& stop_to) const {
     return geo::ComputeDistance(stop_from.coordinates, stop_to.coordinates);
@@ -92,19 +186,39 @@ void TransportRouter::SetVelocity(double vel) {
     bus_velocity_ = vel;
 }
 
-graph::DirectedWeightedGraph<double>& TransportRouter::GetGraph() {
+graph::CsrGraph<double>& TransportRouter::GetGraph() {
     return graph_;
 }
 
-std::map<size_t, EdgeInfo>& TransportRouter::GetEdges() {
+std::vector<EdgeInfo>& TransportRouter::GetEdges() {
     return edge_id_to_info_;
 }
 
-std::map<std::string_view, size_t>& TransportRouter::GetStopnameToId() {
-    return stopname_to_id_;
+RouterType TransportRouter::GetRouterType() const {
+    return router_type_;
+}
+
+void TransportRouter::SetRouterType(RouterType router_type) {
+    router_type_ = router_type;
+}
+
+GraphModel TransportRouter::GetGraphModel() const {
+    return graph_model_;
+}
+
+void TransportRouter::SetGraphModel(GraphModel graph_model) {
+    graph_model_ = graph_model;
+}
+
+size_t TransportRouter::GetRouteCacheSize() const {
+    return route_cache_size_;
+}
+
+void TransportRouter::SetRouteCacheSize(size_t route_cache_size) {
+    route_cache_size_ = route_cache_size;
 }
 
-std::unique_ptr<graph::Router<double>>& TransportRouter::GetRouter() {
+std::unique_ptr<graph::RouterBase<double>>& TransportRouter::GetRouter() {
     return router_;
 }
 
@@ -6,15 +6,28 @@
 #include "router.h"
 
 #include <string_view>
-#include <map>
+#include <cstdint>
 
 enum EdgeType {
     WAIT,
     BUS_T
 };
 
+// Алгоритм поиска маршрута, задаётся ключом router_type в routing_settings
+enum RouterType {
+    ALL_PAIRS,  // предрасчёт таблицы маршрутов между всеми парами вершин
+    DIJKSTRA,   // поиск алгоритмом Дейкстры при каждом запросе
+    CONTRACTION_HIERARCHIES // предрасчёт иерархий сжатия и двунаправленный поиск по ним
+};
+
+// Модель графа маршрутов, задаётся ключом graph_model в routing_settings
+enum GraphModel {
+    STOP_PAIRS, // ребро от каждой остановки до каждой следующей остановки автобуса, O(n^2) рёбер на маршрут
+    BUS_CHAINS  // цепочка вершин поездки на каждый маршрут: посадка, перегоны и выход, O(n) рёбер на маршрут
+};
+
 struct EdgeInfo {
-    std::string_view name;
+    uint32_t id = 0;    //номер остановки для ожидания, номер автобуса для поездки
     int span_count = 0;
     double time = 0.0;
     EdgeType type;
@@ -29,11 +42,19 @@ struct RouteInfo {
 
 class TransportRouter {
 public:
-    TransportRouter(size_t bus_wait_time, size_t bus_velocity, TransportCatalogue& db);
+    //Маршрутизатор строится в пуле thread_pool, без пула — в вызывающем потоке
+    TransportRouter(size_t bus_wait_time, size_t bus_velocity, TransportCatalogue& db,
+                    RouterType router_type = RouterType::ALL_PAIRS,
+                    GraphModel graph_model = GraphModel::STOP_PAIRS,
+                    ThreadPool* thread_pool = nullptr);
     TransportRouter(TransportCatalogue& db)
         : db_(db) {};
 
     std::optional<RouteInfo> SearchRoute(std::string_view from, std::string_view to) const;
+    std::optional<RouteInfo> SearchRoute(uint32_t from_id, uint32_t to_id) const;
+
+    //Номер остановки по названию, для неизвестной остановки — исключение std::out_of_range
+    uint32_t GetStopId(std::string_view stopname) const;
 
     size_t GetWaitTime() const;
     double GetVelocity() const;
@@ -41,50 +62,96 @@ public:
     void SetWaitTime(size_t time);
     void SetVelocity(double vel);
 
-    graph::DirectedWeightedGraph<double>& GetGraph();
+    RouterType GetRouterType() const;
+    void SetRouterType(RouterType router_type);
 
-    std::map<size_t, EdgeInfo>& GetEdges();
-    std::map<std::string_view, size_t>& GetStopnameToId();
+    GraphModel GetGraphModel() const;
+    void SetGraphModel(GraphModel graph_model);
 
-    std::unique_ptr<graph::Router<double>>& GetRouter();
+    //Число маршрутов в кеше ответов на запросы Route, 0 — кеш выключен
+    size_t GetRouteCacheSize() const;
+    void SetRouteCacheSize(size_t route_cache_size);
+
+    graph::CsrGraph<double>& GetGraph();
+
+    std::vector<EdgeInfo>& GetEdges();
+
+    std::unique_ptr<graph::RouterBase<double>>& GetRouter();
+
+    //Создание маршрутизатора выбранного типа по уже построенному графу
+    void BuildRouter(ThreadPool* thread_pool = nullptr);
 
 private:
     size_t bus_wait_time_;
     double bus_velocity_;
+    RouterType router_type_ = RouterType::ALL_PAIRS;
+    GraphModel graph_model_ = GraphModel::STOP_PAIRS;
+    size_t route_cache_size_ = 0;
     TransportCatalogue& db_;
-    graph::DirectedWeightedGraph<double> graph_;
-    std::unique_ptr<graph::Router<double>> router_;
-    std::map<std::string_view, size_t> stopname_to_id_;
-    std::map<size_t, EdgeInfo> edge_id_to_info_;
-
-    EdgeInfo BuildEdgeInfo(std::string_view name, double time, EdgeType type, size_t span_count = 0);
+    //Граф, в который добавляются рёбра при построении, и готовый граф, по которому ищутся маршруты
+    graph::DirectedWeightedGraph<double> graph_builder_;
+    graph::CsrGraph<double> graph_;
+    std::unique_ptr<graph::RouterBase<double>> router_;
+    //Описание ребра по его номеру в графе
+    std::vector<EdgeInfo> edge_id_to_info_;
+
+    EdgeInfo BuildEdgeInfo(uint32_t id, double time, EdgeType type, size_t span_count = 0);
     double ComputeStopsDistance(const Stop& stop_from, const Stop& stop_to) const;
+    size_t CountVertices() const;
+    graph::VertexId GetStopVertex(size_t stop_id) const;
+    void AddEdge(const graph::Edge<double>& edge, const EdgeInfo& edge_info);
     void AddWaitEdges();
     void AddBusesEdges();
     void AddEdgesForBus(const Bus& bus);
+    void FreezeGraph();
+    graph::VertexId AddRideChainsForBus(const Bus& bus, graph::VertexId ride_vertex);
     template <typename It>
-    void AddEdges(const It begin, const It end, std::string_view busname);
+    void AddEdges(const It begin, const It end, uint32_t bus_id);
+    template <typename It>
+    graph::VertexId AddRideChain(const It begin, const It end, uint32_t bus_id, graph::VertexId ride_vertex);
 };
 
 
 
 template <typename It>
-void TransportRouter::AddEdges(const It begin, const It end, std::string_view busname) {
+void TransportRouter::AddEdges(const It begin, const It end, uint32_t bus_id) {
 
-    auto distances = db_.GetDistancesToStops();
     auto iter_last_stop = std::prev(end);
     for(auto iter_stops = begin; iter_stops != iter_last_stop; ++iter_stops) {
         graph::Edge<double> edge;
-        edge.from = stopname_to_id_.at((*iter_stops)->stopname) * 2 + 1;
+        edge.from = (*iter_stops)->id * 2 + 1;
         double time = 0.0;
         size_t span_count = 0;
         for(auto iter_sub_stops = next(iter_stops); iter_sub_stops != std::next(iter_last_stop); ++iter_sub_stops) {
-            double distance = distances.at({*std::prev(iter_sub_stops), *iter_sub_stops});
+            double distance = db_.GetDistance((*std::prev(iter_sub_stops))->id, (*iter_sub_stops)->id);
             time += (distance / bus_velocity_);
-            edge.to = stopname_to_id_.at((*iter_sub_stops)->stopname) * 2;
+            edge.to = (*iter_sub_stops)->id * 2;
             edge.weight = time;
 
-            edge_id_to_info_[graph_.AddEdge(edge)] = BuildEdgeInfo(busname, time, EdgeType::BUS_T, ++span_count);
+            AddEdge(edge, BuildEdgeInfo(bus_id, time, EdgeType::BUS_T, ++span_count));
+        }
+    }
+}
+
+//Цепочка вершин поездки ride_vertex, ride_vertex + 1, ... по остановкам [begin, end):
+//посадка с ожиданием на каждой остановке, кроме конечной, перегон к следующей остановке
+//и бесплатный выход на каждой остановке, кроме начальной. Возвращает первую свободную вершину
+template <typename It>
+graph::VertexId TransportRouter::AddRideChain(const It begin, const It end, uint32_t bus_id,
+                                              graph::VertexId ride_vertex) {
+
+    auto iter_last_stop = std::prev(end);
+    for(auto iter_stops = begin; iter_stops != end; ++iter_stops, ++ride_vertex) {
+        const graph::VertexId stop_vertex = GetStopVertex((*iter_stops)->id);
+        if (iter_stops != begin) {
+            AddEdge({ride_vertex, stop_vertex, 0.0}, BuildEdgeInfo(bus_id, 0.0, EdgeType::BUS_T));
+        }
+        if (iter_stops != iter_last_stop) {
+            const double time = db_.GetDistance((*iter_stops)->id, (*std::next(iter_stops))->id) / bus_velocity_;
+            AddEdge({stop_vertex, ride_vertex, static_cast<double>(bus_wait_time_)},
+                    BuildEdgeInfo((*iter_stops)->id, bus_wait_time_, EdgeType::WAIT));
+            AddEdge({ride_vertex, ride_vertex + 1, time}, BuildEdgeInfo(bus_id, time, EdgeType::BUS_T, 1));
         }
     }
+    return ride_vertex;
 }